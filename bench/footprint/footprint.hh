@@ -0,0 +1,79 @@
+#ifndef TXFLASH_FOOTPRINT_HH
+#define TXFLASH_FOOTPRINT_HH
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+/**
+ * Symbols left to the final firmware: footprint objects are compiled only, never linked, so that flash banks and the
+ * default payload don't account for their sizes.
+ */
+extern "C" {
+extern uint8_t footprint_bank0[];
+extern uint8_t footprint_bank1[];
+extern const char footprint_default[];
+extern const uint32_t footprint_default_length;
+extern volatile uint32_t footprint_cycle_counter;
+extern void footprint_program_word(uint32_t address, uint32_t value);
+extern void footprint_erase_sector(uint8_t sector);
+}
+
+namespace txflash {
+namespace footprint {
+
+/**
+ * A flash bank shaped after Stm32f4FlashBank and Stm32f7FlashBank (memory-mapped reads, word programming with byte
+ * programmed unaligned ends), with the HAL calls replaced by external functions.
+ */
+template<uint8_t Sector, uintptr_t Address, size_t Length>
+class Stm32ShapedFlashBank {
+public:
+    static const uint8_t empty_value = 0xff;
+    using position_t = size_t;
+
+    size_t length() const {
+        return Length;
+    }
+
+    void erase() {
+        footprint_erase_sector(Sector);
+    }
+
+    void read_chunk(size_t position, void *destination, size_t length) const {
+        memcpy(destination, (const char *) Address + position, length);
+    }
+
+    void write_chunk(size_t position, const void *source, size_t length) {
+        uintptr_t current = Address + position, end = current + length;
+        const uint8_t *read = (const uint8_t *) source;
+
+        for (; current % 4 && current < end; current++, read++)
+            footprint_program_word(current, *read);
+
+        for (; current + 4 <= end; current += 4, read += 4)
+            footprint_program_word(current, *(const uint32_t *) read);
+
+        for (; current < end; current++, read++)
+            footprint_program_word(current, *read);
+    }
+};
+
+/**
+ * Cycle counter clock, shaped after DWT->CYCCNT.
+ */
+struct CycleClock {
+    using tick_t = uint32_t;
+
+    static tick_t now() {
+        return footprint_cycle_counter;
+    }
+};
+
+using Stm32Bank0 = Stm32ShapedFlashBank<1, 0x08004000, 0x4000>;
+using Stm32Bank1 = Stm32ShapedFlashBank<2, 0x08008000, 0x4000>;
+
+}
+}
+
+#endif //TXFLASH_FOOTPRINT_HH
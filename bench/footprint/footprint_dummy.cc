@@ -0,0 +1,25 @@
+#include <txflash.hh>
+#include <txflash_dummy.hh>
+
+#include "footprint.hh"
+
+namespace {
+
+using Bank = txflash::DummyFlashBank<0xff, uint16_t>;
+using Flash = txflash::TxFlash<Bank, Bank>;
+
+Flash &flash() {
+    static Flash instance(Bank(footprint_bank0, 0x4000), Bank(footprint_bank1, 0x4000), footprint_default, footprint_default_length);
+    return instance;
+}
+
+}
+
+extern "C" bool footprint_dummy_write(const void *payload, uint16_t length) {
+    return flash().write(payload, length);
+}
+
+extern "C" uint16_t footprint_dummy_read(void *destination) {
+    flash().read(destination);
+    return flash().length();
+}
@@ -0,0 +1,16 @@
+#include <txflash_reader.hh>
+
+#include "footprint.hh"
+
+namespace {
+
+using txflash::footprint::Stm32Bank0;
+using txflash::footprint::Stm32Bank1;
+using Reader = txflash::TxFlashReader<Stm32Bank0, Stm32Bank1>;
+
+}
+
+extern "C" size_t footprint_reader_read(void *destination, size_t length) {
+    Reader reader(Stm32Bank0{}, Stm32Bank1{});
+    return reader.read(destination, length);
+}
@@ -0,0 +1,25 @@
+#include <txflash.hh>
+
+#include "footprint.hh"
+
+namespace {
+
+using txflash::footprint::Stm32Bank0;
+using txflash::footprint::Stm32Bank1;
+using Flash = txflash::TxFlash<Stm32Bank0, Stm32Bank1>;
+
+Flash &flash() {
+    static Flash instance(Stm32Bank0(), Stm32Bank1(), footprint_default, footprint_default_length);
+    return instance;
+}
+
+}
+
+extern "C" bool footprint_stm32_write(const void *payload, size_t length) {
+    return flash().write(payload, length);
+}
+
+extern "C" size_t footprint_stm32_read(void *destination) {
+    flash().read(destination);
+    return flash().length();
+}
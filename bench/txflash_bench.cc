@@ -0,0 +1,235 @@
+/**
+ * TxFlash benchmark suite.
+ *
+ * Measures boot parse time vs. record count, write throughput vs. payload size, bank switch cost and read cost vs. bank
+ * size, both on plain RAM banks and on simulated NOR banks, plus the write cost of the STM32 banks over the host HAL
+ * emulation (see host/stm32), whose ns_per_op is the emulated flash controller busy time rather than host time. Results
+ * are printed to stdout as CSV, one line per measurement, so that runs from different commits can be compared. An
+ * optional argument restricts the run to the benchmarks whose name contains it.
+ *
+ * @author Andrea Leofreddi
+ */
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <txflash.hh>
+#include <txflash_dummy.hh>
+#include <txflash_nor.hh>
+#include <txflash_stm32f4.hh>
+#include <txflash_stm32f7.hh>
+
+namespace {
+
+using txflash::DummyFlashBank;
+using txflash::NorFlashBank;
+using txflash::TxFlash;
+
+const std::chrono::milliseconds min_time(100);
+const size_t max_bank_length = 0x10000;
+
+/**
+ * Tracer counting programmed bytes and erases, whatever the underlying bank.
+ */
+struct CountingTracer : txflash::NullTracer {
+    uint64_t programmed_bytes = 0;
+    uint64_t erases = 0;
+
+    void program(uint8_t /* bank */, uint32_t /* position */, uint32_t length) {
+        programmed_bytes += length;
+    }
+
+    void erase_begin(uint8_t /* bank */) {
+        erases++;
+    }
+};
+
+struct RamBank {
+    using bank_t = DummyFlashBank<0xff, uint32_t>;
+    static constexpr const char *name = "ram";
+};
+
+struct NorBank {
+    using bank_t = NorFlashBank<0xff, uint32_t>;
+    static constexpr const char *name = "nor";
+};
+
+/**
+ * Two erased memory areas backing a pair of banks.
+ */
+template<typename Kind>
+class Memory {
+public:
+    using bank_t = typename Kind::bank_t;
+    using flash_t = TxFlash<bank_t, bank_t, CountingTracer>;
+
+    explicit Memory(size_t length) : m_data0(length, 0xff), m_data1(length, 0xff) {
+    }
+
+    flash_t flash(const void *default_payload = nullptr, uint32_t default_length = 0) {
+        return flash_t(bank_t(m_data0.data(), m_data0.size()), bank_t(m_data1.data(), m_data1.size()), default_payload, default_length);
+    }
+
+private:
+    std::vector<uint8_t> m_data0, m_data1;
+};
+
+struct Measure {
+    uint64_t iterations;
+    double ns_per_op;
+};
+
+template<typename Body>
+Measure measure(Body body) {
+    Measure result = {0, 0};
+    auto begin = std::chrono::steady_clock::now(), end = begin;
+
+    for (uint64_t batch = 1; end - begin < min_time; batch *= 2) {
+        for (uint64_t i = 0; i < batch; i++)
+            body();
+        result.iterations += batch;
+        end = std::chrono::steady_clock::now();
+    }
+
+    result.ns_per_op = std::chrono::duration<double, std::nano>(end - begin).count() / result.iterations;
+    return result;
+}
+
+void report(const char *benchmark, const char *bank, size_t parameter, const Measure &measure, const CountingTracer &tracer) {
+    printf("%s,%s,%zu,%llu,%.1f,%.1f,%.4f\n", benchmark, bank, parameter, (unsigned long long) measure.iterations,
+           measure.ns_per_op, (double) tracer.programmed_bytes / measure.iterations, (double) tracer.erases / measure.iterations);
+}
+
+template<typename Kind>
+void bench_parse() {
+    const uint8_t payload[8] = {};
+
+    for (size_t records : {1, 16, 256, 4096}) {
+        Memory<Kind> memory(max_bank_length);
+        {
+            auto flash = memory.flash(payload, sizeof(payload));
+            for (size_t i = 1; i < records; i++)
+                flash.write(payload, sizeof(payload));
+        }
+
+        CountingTracer tracer;
+        Measure result = measure([&] {
+            auto flash = memory.flash(payload, sizeof(payload));
+            tracer.programmed_bytes += flash.tracer().programmed_bytes;
+            tracer.erases += flash.tracer().erases;
+        });
+        report("parse", Kind::name, records, result, tracer);
+    }
+}
+
+template<typename Kind>
+void bench_write() {
+    static uint8_t payload[1024];
+
+    for (size_t length : {4, 16, 64, 256, 1024}) {
+        Memory<Kind> memory(max_bank_length);
+        auto flash = memory.flash();
+        flash.tracer() = CountingTracer();
+
+        Measure result = measure([&] {
+            payload[0]++;
+            flash.write(payload, length);
+        });
+        report("write", Kind::name, length, result, flash.tracer());
+    }
+}
+
+template<typename Kind>
+void bench_switch() {
+    static uint8_t payload[max_bank_length];
+
+    for (size_t bank_length : {0x400, 0x1000, 0x4000, 0x10000}) {
+        Memory<Kind> memory(bank_length);
+        auto flash = memory.flash();
+        flash.tracer() = CountingTracer();
+
+        // A payload filling a whole bank makes every write switch
+        uint32_t length = bank_length - 1 /* bank header */ - 1 /* header */ - sizeof(uint32_t) /* length */ - 1 /* next header */;
+        Measure result = measure([&] {
+            flash.write(payload, length);
+        });
+        report("switch", Kind::name, bank_length, result, flash.tracer());
+    }
+}
+
+template<typename Kind>
+void bench_read() {
+    uint8_t payload[64] = {}, destination[64];
+    volatile uint8_t sink;
+
+    for (size_t bank_length : {0x400, 0x1000, 0x4000, 0x10000}) {
+        Memory<Kind> memory(bank_length);
+        auto flash = memory.flash(payload, sizeof(payload));
+        for (size_t i = 2; i < bank_length / (1 + sizeof(uint32_t) + sizeof(payload)); i++)
+            flash.write(payload, sizeof(payload));
+        flash.tracer() = CountingTracer();
+
+        Measure result = measure([&] {
+            flash.read(destination);
+            sink = destination[flash.length() - 1];
+        });
+        report("read", Kind::name, bank_length, result, flash.tracer());
+    }
+}
+
+/**
+ * Write cost on the STM32 banks, in emulated device time.
+ */
+template<typename Bank0, typename Bank1>
+void bench_device_write(const char *name, stm32_host::Family family) {
+    static uint8_t payload[1024];
+    const uint64_t iterations = 1024;
+
+    for (size_t length : {1, 4, 16, 64, 256, 1024}) {
+        stm32_host::reset(family);
+        TxFlash<Bank0, Bank1, CountingTracer> flash{Bank0(), Bank1()};
+        flash.tracer() = CountingTracer();
+        stm32_host::flash().counters = stm32_host::Counters();
+
+        for (uint64_t i = 0; i < iterations; i++) {
+            payload[0]++;
+            flash.write(payload, length);
+        }
+
+        Measure result = {iterations, (double) stm32_host::flash().counters.busy_ns / iterations};
+        report("device_write", name, length, result, flash.tracer());
+    }
+}
+
+template<typename Kind>
+void bench_all(const std::string &filter) {
+    if (std::string("parse").find(filter) != std::string::npos)
+        bench_parse<Kind>();
+    if (std::string("write").find(filter) != std::string::npos)
+        bench_write<Kind>();
+    if (std::string("switch").find(filter) != std::string::npos)
+        bench_switch<Kind>();
+    if (std::string("read").find(filter) != std::string::npos)
+        bench_read<Kind>();
+}
+
+}
+
+int main(int argc, char **argv) {
+    std::string filter = argc > 1 ? argv[1] : "";
+
+    printf("benchmark,bank,parameter,iterations,ns_per_op,programmed_bytes_per_op,erases_per_op\n");
+    bench_all<RamBank>(filter);
+    bench_all<NorBank>(filter);
+
+    if (std::string("device_write").find(filter) != std::string::npos) {
+        bench_device_write<txflash::Stm32f4FlashBank<FLASH_SECTOR_1, 0x08004000, 0x4000>,
+                txflash::Stm32f4FlashBank<FLASH_SECTOR_2, 0x08008000, 0x4000>>("stm32f4", stm32_host::Family::F4);
+        bench_device_write<txflash::Stm32f7FlashBank<FLASH_SECTOR_1, 0x08008000, 0x8000>,
+                txflash::Stm32f7FlashBank<FLASH_SECTOR_2, 0x08010000, 0x8000>>("stm32f7", stm32_host::Family::F7);
+    }
+
+    return 0;
+}
@@ -0,0 +1,284 @@
+#ifndef STM32_HOST_HH
+#define STM32_HOST_HH
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <sys/mman.h>
+
+#ifndef MAP_FIXED_NOREPLACE
+#define MAP_FIXED_NOREPLACE 0x100000
+#endif
+
+/**
+ * Host stand-in for the subset of ST's STM32F4/STM32F7 HAL used by the TxFlash STM32 banks, so that they can be built,
+ * tested and benchmarked on a PC. Flash is emulated by a memory area mapped at its device address (FLASH_BASE), so that
+ * memory mapped reads work unchanged, and the controller implements:
+ *
+ * - the CR lock, with programs and erases rejected (and flagged in SR) while locked,
+ * - byte, half-word, word and double-word programming, rejecting unaligned addresses,
+ * - NOR bit-clear semantics: programming can only clear bits, only an erase sets them back,
+ * - the sector layout of the emulated family,
+ * - a busy time model, based on typical datasheet figures,
+ * - worn out cells, failing programs (see wear()).
+ *
+ * Operations are counted into stm32_host::flash().counters, and Error_Handler() calls are counted rather than hanging.
+ *
+ * @author Andrea Leofreddi
+ */
+
+typedef enum {
+    HAL_OK = 0x00U,
+    HAL_ERROR = 0x01U,
+    HAL_BUSY = 0x02U,
+    HAL_TIMEOUT = 0x03U
+} HAL_StatusTypeDef;
+
+typedef struct {
+    volatile uint32_t ACR;
+    volatile uint32_t KEYR;
+    volatile uint32_t OPTKEYR;
+    volatile uint32_t SR;
+    volatile uint32_t CR;
+    volatile uint32_t OPTCR;
+} FLASH_TypeDef;
+
+#define FLASH_BASE 0x08000000U
+
+#define FLASH_KEY1 0x45670123U
+#define FLASH_KEY2 0xCDEF89ABU
+
+#define FLASH_SR_EOP 0x00000001U
+#define FLASH_SR_WRPERR 0x00000010U
+#define FLASH_SR_PGAERR 0x00000020U
+#define FLASH_SR_PGPERR 0x00000040U
+#define FLASH_SR_PGSERR 0x00000080U
+
+#define FLASH_CR_PG 0x00000001U
+#define FLASH_CR_SER 0x00000002U
+#define FLASH_CR_LOCK 0x80000000U
+
+#define FLASH_TYPEPROGRAM_BYTE 0x00000000U
+#define FLASH_TYPEPROGRAM_HALFWORD 0x00000001U
+#define FLASH_TYPEPROGRAM_WORD 0x00000002U
+#define FLASH_TYPEPROGRAM_DOUBLEWORD 0x00000003U
+
+// Legacy names, as in stm32_hal_legacy.h
+#define TYPEPROGRAM_BYTE FLASH_TYPEPROGRAM_BYTE
+#define TYPEPROGRAM_HALFWORD FLASH_TYPEPROGRAM_HALFWORD
+#define TYPEPROGRAM_WORD FLASH_TYPEPROGRAM_WORD
+#define TYPEPROGRAM_DOUBLEWORD FLASH_TYPEPROGRAM_DOUBLEWORD
+
+#define FLASH_VOLTAGE_RANGE_1 0x00000000U
+#define FLASH_VOLTAGE_RANGE_2 0x00000001U
+#define FLASH_VOLTAGE_RANGE_3 0x00000002U
+#define FLASH_VOLTAGE_RANGE_4 0x00000003U
+
+#define VOLTAGE_RANGE_1 FLASH_VOLTAGE_RANGE_1
+#define VOLTAGE_RANGE_2 FLASH_VOLTAGE_RANGE_2
+#define VOLTAGE_RANGE_3 FLASH_VOLTAGE_RANGE_3
+#define VOLTAGE_RANGE_4 FLASH_VOLTAGE_RANGE_4
+
+namespace stm32_host {
+
+/**
+ * Emulated family, selecting the sector layout and timings.
+ */
+enum class Family : uint8_t {
+    F4, ///< STM32F40x/41x, 1MB: 4 x 16KB, 64KB, 7 x 128KB sectors
+    F7  ///< STM32F74x/75x, 1MB: 4 x 32KB, 128KB, 3 x 256KB sectors
+};
+
+/**
+ * Flash controller operation counters.
+ */
+struct Counters {
+    uint32_t unlocks;             ///< Unlock key sequences
+    uint32_t locks;               ///< Lock calls
+    uint32_t programs[4];         ///< Program operations, by FLASH_TYPEPROGRAM_* width
+    uint32_t programmed_bytes;    ///< Programmed bytes
+    uint32_t erases;              ///< Sector erases
+    uint32_t errors;              ///< Operations rejected by the controller
+    uint32_t error_handler_calls; ///< Error_Handler() calls
+    uint64_t busy_ns;             ///< Time the controller has been busy
+};
+
+/**
+ * Emulated flash state.
+ */
+struct Flash {
+    static const uint32_t length = 0x100000;
+
+    Family family;
+    uint8_t *memory;
+    FLASH_TypeDef registers;
+    Counters counters;
+    uint32_t worn_begin, worn_end;
+};
+
+inline Flash &flash() {
+    static Flash instance = [] {
+        Flash flash = {};
+        void *memory = mmap((void *) (uintptr_t) FLASH_BASE, Flash::length, PROT_READ | PROT_WRITE,
+                            MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+
+        // Memory mapped reads need flash at its device address
+        if (memory != (void *) (uintptr_t) FLASH_BASE) {
+            fprintf(stderr, "stm32_host: cannot map flash at 0x%08x\n", FLASH_BASE);
+            abort();
+        }
+
+        flash.memory = (uint8_t *) memory;
+        memset(flash.memory, 0xff, Flash::length);
+        flash.registers.CR = FLASH_CR_LOCK;
+        return flash;
+    }();
+    return instance;
+}
+
+/**
+ * Reset the emulated flash: select the family, erase every sector, lock the controller and clear counters.
+ *
+ * \param family Emulated family
+ */
+inline void reset(Family family = Family::F4) {
+    Flash &state = flash();
+
+    state.family = family;
+    memset(state.memory, 0xff, Flash::length);
+    memset((void *) &state.registers, 0, sizeof(state.registers));
+    state.registers.CR = FLASH_CR_LOCK;
+    state.counters = Counters();
+    state.worn_begin = state.worn_end = 0;
+}
+
+/**
+ * Wear out a range of cells, so that programs touching it fail with PGPERR, leaving the cells unchanged. The range is
+ * cleared by reset().
+ *
+ * \param address Range address
+ * \param length Range length, 0 to clear
+ */
+inline void wear(uint32_t address, uint32_t length) {
+    flash().worn_begin = address;
+    flash().worn_end = address + length;
+}
+
+/**
+ * Retrieve the offset and length of a sector in the emulated family.
+ *
+ * \return False when the sector doesn't exist
+ */
+inline bool sector(uint32_t sector, uint32_t &offset, uint32_t &length) {
+    const uint32_t unit = flash().family == Family::F4 ? 0x4000 : 0x8000;
+
+    if (sector < 4) {
+        offset = sector * unit;
+        length = unit;
+    } else if (sector == 4) {
+        offset = 4 * unit;
+        length = 4 * unit;
+    } else if (sector < (flash().family == Family::F4 ? 12U : 8U)) {
+        offset = 8 * unit * (sector - 4);
+        length = 8 * unit;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Typical program time, per operation whatever its width (x32 parallelism).
+ */
+inline uint64_t program_ns() {
+    return 16000;
+}
+
+/**
+ * Typical sector erase time.
+ */
+inline uint64_t erase_ns(uint32_t length) {
+    if (flash().family == Family::F4)
+        return length <= 0x4000 ? 400000000ull : length <= 0x10000 ? 1100000000ull : 2000000000ull;
+    return length <= 0x8000 ? 400000000ull : length <= 0x20000 ? 1100000000ull : 2000000000ull;
+}
+
+inline HAL_StatusTypeDef reject(uint32_t error) {
+    flash().registers.SR |= error;
+    flash().counters.errors++;
+    return HAL_ERROR;
+}
+
+}
+
+#define FLASH (&stm32_host::flash().registers)
+
+inline HAL_StatusTypeDef HAL_FLASH_Unlock(void) {
+    if (FLASH->CR & FLASH_CR_LOCK) {
+        FLASH->KEYR = FLASH_KEY1;
+        FLASH->KEYR = FLASH_KEY2;
+        FLASH->CR &= ~FLASH_CR_LOCK;
+        stm32_host::flash().counters.unlocks++;
+    }
+    return HAL_OK;
+}
+
+inline HAL_StatusTypeDef HAL_FLASH_Lock(void) {
+    FLASH->CR |= FLASH_CR_LOCK;
+    stm32_host::flash().counters.locks++;
+    return HAL_OK;
+}
+
+inline HAL_StatusTypeDef HAL_FLASH_Program(uint32_t TypeProgram, uint32_t Address, uint64_t Data) {
+    stm32_host::Flash &state = stm32_host::flash();
+    const uint32_t width = 1U << TypeProgram;
+
+    if (state.registers.CR & FLASH_CR_LOCK)
+        return stm32_host::reject(FLASH_SR_PGSERR);
+    if (TypeProgram > FLASH_TYPEPROGRAM_DOUBLEWORD || Address % width)
+        return stm32_host::reject(FLASH_SR_PGAERR);
+    if (Address < FLASH_BASE || Address - FLASH_BASE > stm32_host::Flash::length - width)
+        return stm32_host::reject(FLASH_SR_WRPERR);
+    if (Address < state.worn_end && Address + width > state.worn_begin)
+        return stm32_host::reject(FLASH_SR_PGPERR);
+
+    // Programming can only clear bits
+    for (uint32_t i = 0; i < width; i++)
+        state.memory[Address - FLASH_BASE + i] &= (uint8_t) (Data >> 8 * i);
+
+    state.registers.SR |= FLASH_SR_EOP;
+    state.counters.programs[TypeProgram]++;
+    state.counters.programmed_bytes += width;
+    state.counters.busy_ns += stm32_host::program_ns();
+    return HAL_OK;
+}
+
+inline void FLASH_Erase_Sector(uint32_t Sector, uint8_t /* VoltageRange */) {
+    stm32_host::Flash &state = stm32_host::flash();
+    uint32_t offset, length;
+
+    if (state.registers.CR & FLASH_CR_LOCK) {
+        stm32_host::reject(FLASH_SR_PGSERR);
+        return;
+    }
+    if (!stm32_host::sector(Sector, offset, length)) {
+        stm32_host::reject(FLASH_SR_WRPERR);
+        return;
+    }
+
+    memset(state.memory + offset, 0xff, length);
+    state.registers.SR |= FLASH_SR_EOP;
+    state.counters.erases++;
+    state.counters.busy_ns += stm32_host::erase_ns(length);
+}
+
+/**
+ * Application error handler, which hangs on devices: here it's only counted.
+ */
+inline void Error_Handler(void) {
+    stm32_host::flash().counters.error_handler_calls++;
+}
+
+#endif //STM32_HOST_HH
@@ -0,0 +1,10 @@
+#ifndef STM32F4XX_HAL_H
+#define STM32F4XX_HAL_H
+
+/*
+ * Host stand-in for ST's STM32F4 HAL (see stm32_host.hh). Call stm32_host::reset(stm32_host::Family::F4) to emulate
+ * the STM32F4 sector layout.
+ */
+#include "stm32_host.hh"
+
+#endif //STM32F4XX_HAL_H
@@ -0,0 +1,19 @@
+#ifndef STM32F4XX_HAL_FLASH_EX_H
+#define STM32F4XX_HAL_FLASH_EX_H
+
+#include "stm32f4xx_hal.h"
+
+#define FLASH_SECTOR_0 0U
+#define FLASH_SECTOR_1 1U
+#define FLASH_SECTOR_2 2U
+#define FLASH_SECTOR_3 3U
+#define FLASH_SECTOR_4 4U
+#define FLASH_SECTOR_5 5U
+#define FLASH_SECTOR_6 6U
+#define FLASH_SECTOR_7 7U
+#define FLASH_SECTOR_8 8U
+#define FLASH_SECTOR_9 9U
+#define FLASH_SECTOR_10 10U
+#define FLASH_SECTOR_11 11U
+
+#endif //STM32F4XX_HAL_FLASH_EX_H
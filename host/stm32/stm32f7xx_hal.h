@@ -0,0 +1,10 @@
+#ifndef STM32F7XX_HAL_H
+#define STM32F7XX_HAL_H
+
+/*
+ * Host stand-in for ST's STM32F7 HAL (see stm32_host.hh). Call stm32_host::reset(stm32_host::Family::F7) to emulate
+ * the STM32F7 sector layout.
+ */
+#include "stm32_host.hh"
+
+#endif //STM32F7XX_HAL_H
@@ -2,25 +2,46 @@
 #define TXFLASH_HH
 
 #include <algorithm>
+#include <cassert>
+#include <cstddef>
 #include <cstdint>
-#include <cstdio>
 #include <type_traits>
 
-#ifndef TXFLASH_DEBUG
-# define TXFLASH_DEBUG(...)
-#endif
+#include "txflash_bank.hh"
+#include "txflash_format.hh"
+#include "txflash_observer.hh"
+#include "txflash_tracer.hh"
 
 namespace txflash {
 
+/**
+ * Tag type requesting TxFlash to defer parsing flash from construction to begin() (see defer_init).
+ */
+struct DeferInit {
+};
+
+/**
+ * Tag requesting TxFlash to defer parsing flash from construction to begin() or to the first modifying call (eg. a
+ * write), so that global instances don't scan (and possibly erase) flash during static initialization.
+ */
+static const DeferInit defer_init = {};
+
 /**
  * Transactional flash storage. This class allows for transactional storage of arbitrary data into a two banks flash storage.
  *
+ * \tparam Bank0 1st bank type
+ * \tparam Bank1 2nd bank type
+ * \tparam Tracer Tracer policy notified of flash events (see NullTracer)
+ * \tparam Alignment Payload alignment, a power of 2 (see view())
+ * \tparam Observers Maximum number of observers notified of configuration changes (see subscribe())
+ *
  * @author Andrea Leofreddi
  */
-template<typename Bank0, typename Bank1>
+template<typename Bank0, typename Bank1, typename Tracer = NullTracer, size_t Alignment = 1, size_t Observers = 0>
 class TxFlash {
 private:
     static_assert(Bank0::empty_value == Bank1::empty_value, "flash banks with different empty value");
+    static_assert(Alignment && !(Alignment & (Alignment - 1)), "alignment is not a power of 2");
 
     static const uint8_t empty_value = Bank0::empty_value;
 
@@ -29,19 +50,13 @@ private:
         BANK1 = 1
     };
 
-    enum class Header : uint8_t {
-        EMPTY = empty_value,
-        RECORD = (uint8_t)((uint16_t) empty_value + 1),
-        SWITCH = (uint8_t)((uint16_t) empty_value + 2)
-    };
+    using position_t = typename std::common_type<typename Bank0::position_t, typename Bank1::position_t>::type;
 
-    enum class State {
-        EMPTY,
-        VALID,
-        INVALID
-    };
+    using Format = RecordFormat<empty_value, position_t>;
+    using Header = typename Format::Header;
+    using State = typename Format::State;
 
-    using position_t = typename std::common_type<typename Bank0::position_t, typename Bank1::position_t>::type;
+    static_assert(Alignment <= Format::max_alignment, "alignment too large");
 
     const void *m_default_payload;
     const position_t m_default_payload_length;
@@ -49,22 +64,109 @@ private:
     Bank0 m_bank0;
     Bank1 m_bank1;
 
+    Tracer m_tracer;
+
     Bank m_read_bank, m_write_bank;
+    uint8_t m_version;
+    position_t m_alignment;
     position_t m_read_position, m_write_position;
+    position_t m_reserve;
+    bool m_initialized;
 
     void initialize();
 
+    void recover();
+
     void read_chunk(Bank bank, position_t position, void *destination, position_t length) const;
 
-    void write_chunk(Bank bank, position_t position, const void *data, position_t length);
+    bool write_chunk(Bank bank, position_t position, const void *data, position_t length);
+
+    void erase(Bank bank);
+
+    position_t remaining(Bank bank, position_t position) const;
+
+    position_t available(Bank bank, position_t position, position_t reserve) const;
+
+    position_t write_alignment() const;
 
-    position_t remaining(Bank bank, position_t position);
+    bool append(const void *payload, position_t length, position_t reserve);
+
+    bool program(const void *payload, position_t length);
+
+    bool open_record(position_t length);
+
+    bool commit_record(position_t length);
+
+    bool abandon();
+
+    template<typename Program>
+    bool switch_bank(Program program);
+
+    bool relocate();
+
+    typename Format::Record probe(Bank bank, position_t position) const;
+
+    bool blank(Bank bank, position_t position, position_t length) const;
+
+    void restart_scrub();
 
     State parse();
 
-    State fast_forward();
+    const void *in_place(std::true_type) const;
+
+    const void *in_place(std::false_type) const;
+
+    void cache_cursor();
+
+    static uint32_t checksum(const typename Format::Cursor &cursor);
 
 public:
+    /**
+     * Estimated cost of a write.
+     */
+    struct WriteCost {
+        position_t programmed; ///< Bytes to program, including the record overhead but not the padding left erased
+        uint8_t erases;        ///< Bank erases
+    };
+
+    /**
+     * Flash health, as reported by scrub_step().
+     */
+    enum class Health : uint8_t {
+        SCRUBBING, ///< Pass in progress, no damage found so far
+        HEALTHY,   ///< Pass completed without damage, the next step starts a new one
+        REPAIRED,  ///< Damage found and repaired, by moving the configuration to the other bank or erasing the standby one
+        DAMAGED    ///< The current record is damaged, and will be lost by the next parse
+    };
+
+    /**
+     * Configuration change, notified to observers (see subscribe()).
+     */
+    struct Change {
+        enum class Cause : uint8_t {
+            WRITE,     ///< Stored by write(), write_if() or emergency_write()
+            RESET,     ///< Default configuration stored by reset() or on empty flash
+            RECOVERY,  ///< Rolled back to the default configuration, as flash was corrupted
+            RELOCATION ///< Same configuration, moved to the other bank by scrub_step()
+        };
+
+        Cause cause;
+        uint32_t version;    ///< Record version (see record_version())
+        position_t length;   ///< Configuration length
+        const void *payload; ///< Configuration in place on memory mapped banks (as view()), else nullptr
+    };
+
+    using observer_t = void (*)(void *context, const Change &change);
+
+    /**
+     * Location of the current record, kept across warm resets (see set_cursor_cache()).
+     */
+    struct CursorCache {
+        typename Format::Cursor cursor;
+        uint32_t check;
+        uint32_t digest; ///< Digest of the records the cursor relies on (see RecordFormat::digest())
+    };
+
     /**
      * Initialize the transaction flash using the given flash banks. The default configuration will be used when flash is empty or on unrecoverable error.
      *
@@ -89,6 +191,52 @@ public:
      */
     TxFlash(Bank0 &&bank0, Bank1 &&bank1, const void *default_payload = nullptr, position_t length = 0);
 
+    /**
+     * Construct the transaction flash without accessing flash, which is parsed by begin() or by the first modifying
+     * call. Const accessors (eg. length() or read()) require flash to be parsed first.
+     *
+     * The constructed instance will take ownership of bank0 and bank1 (which will be copied into private fields).
+     *
+     * \param bank0 1st bank
+     * \param bank1 2nd bank
+     * \param default_payload Default configuration payload
+     * \param length  Default configuration length
+     */
+    TxFlash(Bank0 &bank0, Bank1 &bank1, const void *default_payload, position_t length, DeferInit);
+
+    /**
+     * Construct the transaction flash without accessing flash, which is parsed by begin() or by the first modifying
+     * call. Const accessors (eg. length() or read()) require flash to be parsed first.
+     *
+     * The constructed instance will take ownership of bank0 and bank1 (which will be moved into private fields).
+     *
+     * \param bank0 1st bank
+     * \param bank1 2nd bank
+     * \param default_payload Default configuration payload
+     * \param length  Default configuration length
+     */
+    TxFlash(Bank0 &&bank0, Bank1 &&bank1, const void *default_payload, position_t length, DeferInit);
+
+    /**
+     * Parse flash, initializing it with the default configuration when empty or on unrecoverable error. This is done
+     * on construction, unless deferred (see defer_init), and does nothing once done.
+     */
+    void begin();
+
+    /**
+     * Set a cache of the current record location, updated on every write. When valid and still matching flash, it
+     * spares begin() the scan of the current bank. Placing the cache in RAM not initialized on reset (eg. a .noinit
+     * section) makes warm resets find the configuration in constant time; the cache is validated through a checksum,
+     * against the bank headers and the tail of the current bank, and against a digest of the first and current records
+     * read back from flash, so that stale or garbage content, or flash reprovisioned meanwhile, only costs a full scan.
+     * Keeping the digest up to date reads the record back after every write.
+     *
+     * To be called before begin(), ie. on deferred instances (see defer_init).
+     *
+     * \param cache Cache, or nullptr to disable caching
+     */
+    void set_cursor_cache(CursorCache *cache);
+
     /**
      * Retrieve the current configuration length.
      *
@@ -103,6 +251,20 @@ public:
      */
     void read(void *destination) const;
 
+    /**
+     * Access the configuration in place, on memory mapped banks (ie. providing a const uint8_t *data() method). The
+     * configuration is available as long as it is not replaced by a later write.
+     *
+     * Payloads start on an Alignment boundary relative to the bank start, so banks should be placed on such a boundary
+     * too. Records written before the alignment was set (eg. by an older firmware) are unaligned until the next bank
+     * switch.
+     *
+     * \tparam T Configuration type, trivially copyable
+     * \return Configuration, nullptr when shorter than T or not suitably aligned
+     */
+    template<typename T>
+    const T *view() const;
+
     /**
      * Store a new configuration.
      *
@@ -113,38 +275,201 @@ public:
     bool write(const void *payload, position_t length);
 
     /**
-     * Reset the configuration to the default one.
+     * Store a new configuration, unless another one has been stored since the expected version was read (see
+     * record_version()), so that tasks updating parts of the configuration can read, modify and write it back without
+     * holding a lock across the whole cycle. A conflict fails before accessing flash, and the caller should read the
+     * configuration again and retry.
+     *
+     * TxFlash is not thread safe, so calls still have to be serialized (eg. by a mutex held for the call only).
+     *
+     * \param expected_version Record version the new configuration is based on
+     * \param payload The configuration to store
+     * \param length Length of the configuration to store
+     * \return True if the operations succeed, false on conflict or as write()
+     */
+    bool write_if(uint32_t expected_version, const void *payload, position_t length);
+
+    /**
+     * Retrieve the version of the current configuration, increasing with every stored configuration (including
+     * reset() and the default one stored on recovery), while bank switches and relocations keep it. Versions are kept
+     * in RAM and count from 0 on begin(), as conflicting writers can only be tasks of the same boot.
+     *
+     * \return Record version
+     */
+    uint32_t record_version() const;
+
+    /**
+     * Store a new configuration, possibly using the reserve (see set_reserve()). A configuration fitting the current
+     * bank including the reserve is stored by programming alone, so within a bounded time (eg. on brown-out); larger
+     * ones are stored as by write().
+     *
+     * \param payload The configuration to store
+     * \param length Length of the configuration to store
+     * \return True if the operations succeed, else return false (eg. when the payload doesn't fit the flash due to excessive length)
+     */
+    bool emergency_write(const void *payload, position_t length);
+
+    /**
+     * Set the space kept programmable at the end of the current bank for emergency_write(). Regular writes not leaving
+     * the reserve free switch bank early. Defaults to no reserve.
+     *
+     * \param length Reserved length in bytes, including the record overhead (eg. the record_size() of the largest
+     *        emergency configuration)
+     */
+    void set_reserve(position_t length);
+
+    /**
+     * Retrieve the space left for regular writes in the current bank, before a bank switch is needed.
+     *
+     * \return Free space in bytes, including the record overhead (see record_size())
+     */
+    position_t free_space() const;
+
+    /**
+     * Tell whether writing a configuration of the given length would switch bank (so erase).
+     *
+     * \param length Configuration length
+     * \return True if write() would switch bank
+     */
+    bool will_switch(position_t length) const;
+
+    /**
+     * Estimate the cost of writing a configuration of the given length, so that expensive writes can be scheduled
+     * (eg. in idle time).
+     *
+     * \param length Configuration length
+     * \return Write cost, zero when the configuration doesn't fit the flash
+     */
+    WriteCost estimated_cost(position_t length) const;
+
+    /**
+     * Compute the flash space taken by a configuration, including the record overhead.
+     *
+     * \param length Configuration length
+     * \return Record size
+     */
+    static position_t record_size(position_t length);
+
+    /**
+     * Retrieve the format version of the current bank. Banks written by older versions are still appended to, and get
+     * upgraded to the current version (RecordFormat::version) by the next bank switch.
+     *
+     * \return Format version
+     */
+    uint8_t format_version() const;
+
+    /**
+     * Check a slice of flash for latent corruption, so that integrity checks cost spare cycles instead of boot time.
+     * Successive steps walk the records of the current bank (checking the bank header, record headers, lengths and
+     * erased padding), its free space and the standby bank, then start over. Damage to older records or to space
+     * expected to be erased is reported to the tracer and repaired by an early bank switch moving the configuration, or
+     * by erasing the standby bank, so that neither the next parse nor the next switch trips on it.
+     *
+     * Records carry no checksum, so payloads are not checked.
+     *
+     * \param length Budget in bytes to read, at least a record or a chunk of erased space is checked
+     * \return Health state
+     */
+    Health scrub_step(position_t length);
+
+    /**
+     * Reset the configuration to the default one, which is appended as a regular record (so no erase is needed unless
+     * the current bank is full).
      */
     void reset();
+
+    /**
+     * Subscribe an observer to configuration changes, so that consumers don't need to poll. Observers are called in
+     * subscription order once the new configuration is committed, and must not write to the flash.
+     *
+     * \param observer Observer function
+     * \param context Context passed to the observer
+     * \return False when Observers observers are already subscribed
+     */
+    bool subscribe(observer_t observer, void *context = nullptr);
+
+    /**
+     * Unsubscribe an observer, matching both the function and the context.
+     *
+     * \return False when not subscribed
+     */
+    bool unsubscribe(observer_t observer, void *context = nullptr);
+
+    /**
+     * Retrieve the tracer instance.
+     *
+     * \return Tracer
+     */
+    Tracer &tracer();
+
+private:
+    enum class ScrubPhase : uint8_t {
+        RECORDS,
+        FREE,
+        STANDBY
+    };
+
+    CursorCache *m_cache;
+    ObserverList<Change, Observers> m_observers;
+    uint32_t m_record_version;
+    ScrubPhase m_scrub_phase;
+    position_t m_scrub_position;
+
+    Health damage(Recovery reason, Bank bank, position_t position, bool repairable);
+
+    bool write(const void *payload, position_t length, typename Change::Cause cause);
+
+    void notify(typename Change::Cause cause);
 };
 
-template<typename Bank0, typename Bank1>
-TxFlash<Bank0, Bank1>::TxFlash(Bank0 &bank0, Bank1 &bank1, const void *default_payload, typename TxFlash<Bank0, Bank1>::position_t length)
-        : m_bank0(bank0), m_bank1(bank1), m_default_payload(default_payload), m_default_payload_length(length) {
-    initialize();
+template<typename Bank0, typename Bank1, typename Tracer, size_t Alignment, size_t Observers>
+TxFlash<Bank0, Bank1, Tracer, Alignment, Observers>::TxFlash(Bank0 &bank0, Bank1 &bank1, const void *default_payload, typename TxFlash<Bank0, Bank1, Tracer, Alignment, Observers>::position_t length)
+        : m_bank0(bank0), m_bank1(bank1), m_default_payload(default_payload), m_default_payload_length(length), m_reserve(0), m_initialized(false), m_cache(nullptr) {
+    begin();
 }
 
-template<typename Bank0, typename Bank1>
-TxFlash<Bank0, Bank1>::TxFlash(Bank0 &&bank0, Bank1 &&bank1, const void *default_payload, typename TxFlash<Bank0, Bank1>::position_t length)
-        : m_bank0(std::move(bank0)), m_bank1(std::move(bank1)), m_default_payload(default_payload), m_default_payload_length(length) {
+template<typename Bank0, typename Bank1, typename Tracer, size_t Alignment, size_t Observers>
+TxFlash<Bank0, Bank1, Tracer, Alignment, Observers>::TxFlash(Bank0 &&bank0, Bank1 &&bank1, const void *default_payload, typename TxFlash<Bank0, Bank1, Tracer, Alignment, Observers>::position_t length)
+        : m_bank0(std::move(bank0)), m_bank1(std::move(bank1)), m_default_payload(default_payload), m_default_payload_length(length), m_reserve(0), m_initialized(false), m_cache(nullptr) {
+    begin();
+}
+
+template<typename Bank0, typename Bank1, typename Tracer, size_t Alignment, size_t Observers>
+TxFlash<Bank0, Bank1, Tracer, Alignment, Observers>::TxFlash(Bank0 &bank0, Bank1 &bank1, const void *default_payload, typename TxFlash<Bank0, Bank1, Tracer, Alignment, Observers>::position_t length, DeferInit)
+        : m_bank0(bank0), m_bank1(bank1), m_default_payload(default_payload), m_default_payload_length(length), m_reserve(0), m_initialized(false), m_cache(nullptr) {
+}
+
+template<typename Bank0, typename Bank1, typename Tracer, size_t Alignment, size_t Observers>
+TxFlash<Bank0, Bank1, Tracer, Alignment, Observers>::TxFlash(Bank0 &&bank0, Bank1 &&bank1, const void *default_payload, typename TxFlash<Bank0, Bank1, Tracer, Alignment, Observers>::position_t length, DeferInit)
+        : m_bank0(std::move(bank0)), m_bank1(std::move(bank1)), m_default_payload(default_payload), m_default_payload_length(length), m_reserve(0), m_initialized(false), m_cache(nullptr) {
+}
+
+template<typename Bank0, typename Bank1, typename Tracer, size_t Alignment, size_t Observers>
+void TxFlash<Bank0, Bank1, Tracer, Alignment, Observers>::begin() {
+    if (m_initialized)
+        return;
+
+    // Set first, as initialization writes through the public interface
+    m_initialized = true;
     initialize();
 }
 
-template<typename Bank0, typename Bank1>
-void TxFlash<Bank0, Bank1>::initialize() {
-    State state = parse();
+template<typename Bank0, typename Bank1, typename Tracer, size_t Alignment, size_t Observers>
+void TxFlash<Bank0, Bank1, Tracer, Alignment, Observers>::initialize() {
+    m_record_version = 0;
+    restart_scrub();
 
-    TXFLASH_DEBUG("Parsed flash, state %i, read index 0x%x@#%i, write index 0x%x@#%i\n", state, m_read_position, m_read_bank, m_write_position, m_write_bank);
+    m_tracer.parse_begin();
+    State state = parse();
+    m_tracer.parse_end((uint8_t) state);
 
     switch (state) {
         case State::INVALID:
-            TXFLASH_DEBUG("Flash content is invalid\n");
-            reset();
+            recover();
             break;
 
         case State::EMPTY:
-            TXFLASH_DEBUG("Initializing empty flash with default payload\n");
-            write(m_default_payload, m_default_payload_length);
+            write(m_default_payload, m_default_payload_length, Change::Cause::RESET);
             break;
 
         default:
@@ -152,178 +477,576 @@ void TxFlash<Bank0, Bank1>::initialize() {
     }
 }
 
-template<typename Bank0, typename Bank1>
-typename TxFlash<Bank0, Bank1>::State TxFlash<Bank0, Bank1>::fast_forward() {
-    for (Header header;;) {
-        position_t length;
+template<typename Bank0, typename Bank1, typename Tracer, size_t Alignment, size_t Observers>
+typename TxFlash<Bank0, Bank1, Tracer, Alignment, Observers>::State TxFlash<Bank0, Bank1, Tracer, Alignment, Observers>::parse() {
+    typename Format::Cursor cursor;
+    State state;
 
-        if (remaining(m_read_bank, m_read_position) <
-            1 /* header */ + sizeof(position_t) /* length */ + 1 /* next header */) {
-            TXFLASH_DEBUG("Unexpected invalid open record at 0x%x@#%i\n", m_read_position, m_read_bank);
-            return State::INVALID;
-        }
+    bool cached = m_cache && m_cache->check == checksum(m_cache->cursor) &&
+                  Format::matches(m_bank0, m_bank1, m_cache->cursor) &&
+                  m_cache->digest == Format::digest(m_bank0, m_bank1, m_cache->cursor);
 
-        // Read length
-        read_chunk(m_read_bank, m_read_position + 1 /* header */, &length, sizeof(position_t));
-
-        if (remaining(m_read_bank, m_read_position) < 1 /* header */ + sizeof(position_t) /* length */ + length + 1 /* next header */) {
-            TXFLASH_DEBUG("Unexpected invalid record length 0x%x at 0x%x@#%i\n", length, m_read_position, m_read_bank);
-            return State::INVALID;
-        }
+    if (cached) {
+        cursor = m_cache->cursor;
+        state = State::VALID;
+    } else {
+        state = Format::locate(m_bank0, m_bank1, cursor, m_tracer);
+    }
 
-        // Advance write position and read next header
-        m_write_position =
-                m_read_position + 1 /* header */ + sizeof(position_t) /* length */ + length /* payload */;
-        read_chunk(m_read_bank, m_write_position, &header, 1);
+    m_read_bank = m_write_bank = cursor.bank ? Bank::BANK1 : Bank::BANK0;
+    m_version = cursor.version;
+    m_alignment = cursor.alignment;
+    m_read_position = cursor.read_position;
+    m_write_position = cursor.write_position;
 
-        if (header == Header::EMPTY)
-            break;
+    if (state == State::VALID && !cached)
+        cache_cursor();
+    return state;
+}
 
-        if (header != Header::RECORD) {
-            TXFLASH_DEBUG("Unexpected header 0x%x at 0x%x@#%i\n", header, m_write_position, m_read_bank);
-            return State::INVALID;
-        }
+template<typename Bank0, typename Bank1, typename Tracer, size_t Alignment, size_t Observers>
+void TxFlash<Bank0, Bank1, Tracer, Alignment, Observers>::cache_cursor() {
+    if (!m_cache)
+        return;
+
+    typename Format::Cursor &cursor = m_cache->cursor;
+    cursor.bank = (uint8_t) m_write_bank;
+    cursor.version = m_version;
+    cursor.alignment = m_alignment;
+    cursor.read_position = m_read_position;
+    cursor.write_position = m_write_position;
+    m_cache->check = checksum(cursor);
+    m_cache->digest = Format::digest(m_bank0, m_bank1, cursor);
+}
 
-        m_read_position = m_write_position;
-    }
+template<typename Bank0, typename Bank1, typename Tracer, size_t Alignment, size_t Observers>
+uint32_t TxFlash<Bank0, Bank1, Tracer, Alignment, Observers>::checksum(const typename Format::Cursor &cursor) {
+    const uint64_t fields[] = {cursor.bank, cursor.version, cursor.alignment, cursor.read_position, cursor.write_position};
+    uint32_t hash = 2166136261u; // FNV-1a, so that zeroed or random RAM doesn't pass
 
-    return State::VALID;
+    for (uint64_t field : fields)
+        for (uint8_t i = 0; i < sizeof(field); i++)
+            hash = (hash ^ (uint8_t) (field >> 8 * i)) * 16777619u;
+    return hash;
 }
 
-template<typename Bank0, typename Bank1>
-typename TxFlash<Bank0, Bank1>::State TxFlash<Bank0, Bank1>::parse() {
-    Header headerBank0, headerBank1;
+template<typename Bank0, typename Bank1, typename Tracer, size_t Alignment, size_t Observers>
+void TxFlash<Bank0, Bank1, Tracer, Alignment, Observers>::set_cursor_cache(CursorCache *cache) {
+    m_cache = cache;
+}
 
-    // Reset pointers
-    m_read_bank = m_write_bank = Bank::BANK0;
-    m_read_position = m_write_position = 0;
+template<typename Bank0, typename Bank1, typename Tracer, size_t Alignment, size_t Observers>
+typename TxFlash<Bank0, Bank1, Tracer, Alignment, Observers>::position_t TxFlash<Bank0, Bank1, Tracer, Alignment, Observers>::length() const {
+    assert(m_initialized && "begin() not called");
+    return m_read_bank == Bank::BANK0 ? Format::length(m_bank0, m_read_position)
+                                      : Format::length(m_bank1, m_read_position);
+}
 
-    // Read BANK0 header
-    read_chunk(Bank::BANK0, 0, &headerBank0, 1);
-    read_chunk(Bank::BANK1, 0, &headerBank1, 1);
-
-    // If bank0 seems empty, verify bank1
-    TXFLASH_DEBUG("Bank0 %s, bank1 %s\n",
-                  headerBank0 == Header::EMPTY ? "empty" : "non-empty",
-                  headerBank1 == Header::EMPTY ? "empty" : "non-empty");
-
-    if (headerBank0 == Header::EMPTY && headerBank1 == Header::EMPTY) {
-        TXFLASH_DEBUG("Empty flash, initializing with default payload\n");
-        return State::EMPTY;
-    } else if (headerBank0 == Header::EMPTY && headerBank1 == Header::RECORD) {
-        m_read_bank = m_write_bank = Bank::BANK1;
-        return fast_forward();
-    } else if (headerBank0 == Header::RECORD && headerBank1 == Header::EMPTY) {
-        return fast_forward();
-    } else if (headerBank0 == Header::RECORD && headerBank1 == Header::RECORD) {
-        m_read_bank = m_write_bank = Bank::BANK1;
-        return fast_forward();
-    } else {
-        TXFLASH_DEBUG("Corrupted, unrecoverable payload. Initializing with default payload\n");
-        return State::INVALID;
-    }
+template<typename Bank0, typename Bank1, typename Tracer, size_t Alignment, size_t Observers>
+typename TxFlash<Bank0, Bank1, Tracer, Alignment, Observers>::position_t
+TxFlash<Bank0, Bank1, Tracer, Alignment, Observers>::remaining(Bank bank, position_t position) const {
+    // An erased bank gets its bank header along with the first record
+    if (!position)
+        position = Format::first(Format::version, Alignment);
+    return bank == Bank::BANK0 ? m_bank0.length() - position : m_bank1.length() - position;
 }
 
-template<typename Bank0, typename Bank1>
-typename TxFlash<Bank0, Bank1>::position_t TxFlash<Bank0, Bank1>::length() const {
-    position_t length;
-    read_chunk(m_read_bank, m_read_position + 1, &length, sizeof(position_t));
-    return length;
+template<typename Bank0, typename Bank1, typename Tracer, size_t Alignment, size_t Observers>
+typename TxFlash<Bank0, Bank1, Tracer, Alignment, Observers>::position_t
+TxFlash<Bank0, Bank1, Tracer, Alignment, Observers>::available(Bank bank, position_t position, position_t reserve) const {
+    position_t remaining = this->remaining(bank, position);
+    return remaining > reserve ? remaining - reserve : 0;
 }
 
-template<typename Bank0, typename Bank1>
-typename TxFlash<Bank0, Bank1>::position_t
-TxFlash<Bank0, Bank1>::remaining(Bank bank, position_t position) {
-    return bank == Bank::BANK0 ? m_bank0.length() - position : m_bank1.length() - position;
+template<typename Bank0, typename Bank1, typename Tracer, size_t Alignment, size_t Observers>
+typename TxFlash<Bank0, Bank1, Tracer, Alignment, Observers>::position_t TxFlash<Bank0, Bank1, Tracer, Alignment, Observers>::write_alignment() const {
+    // Records are appended with the alignment of the current bank, an erased bank gets the configured one
+    return m_write_position ? m_alignment : Alignment;
 }
 
-template<typename Bank0, typename Bank1>
-void TxFlash<Bank0, Bank1>::read_chunk(Bank bank, position_t position, void *destination,
-                                       position_t length) const {
+template<typename Bank0, typename Bank1, typename Tracer, size_t Alignment, size_t Observers>
+void TxFlash<Bank0, Bank1, Tracer, Alignment, Observers>::read_chunk(Bank bank, position_t position, void *destination,
+                                               position_t length) const {
     return bank == Bank::BANK0 ? m_bank0.read_chunk(position, destination, length)
                                : m_bank1.read_chunk(position, destination, length);
 }
 
-template<typename Bank0, typename Bank1>
-void TxFlash<Bank0, Bank1>::write_chunk(Bank bank, position_t position, const void *destination,
-                                        position_t length) {
-    return bank == Bank::BANK0 ? m_bank0.write_chunk(position, destination, length)
-                               : m_bank1.write_chunk(position, destination, length);
+template<typename Bank0, typename Bank1, typename Tracer, size_t Alignment, size_t Observers>
+bool TxFlash<Bank0, Bank1, Tracer, Alignment, Observers>::write_chunk(Bank bank, position_t position, const void *destination,
+                                                position_t length) {
+    m_tracer.program((uint8_t) bank, position, length);
+    return bank == Bank::BANK0 ? program_chunk(m_bank0, position, destination, length)
+                               : program_chunk(m_bank1, position, destination, length);
 }
 
-template<typename Bank0, typename Bank1>
-void TxFlash<Bank0, Bank1>::read(void *destination) const {
+template<typename Bank0, typename Bank1, typename Tracer, size_t Alignment, size_t Observers>
+void TxFlash<Bank0, Bank1, Tracer, Alignment, Observers>::erase(Bank bank) {
+    m_tracer.erase_begin((uint8_t) bank);
+    if (bank == Bank::BANK0)
+        m_bank0.erase();
+    else
+        m_bank1.erase();
+    m_tracer.erase_end((uint8_t) bank);
+}
+
+template<typename Bank0, typename Bank1, typename Tracer, size_t Alignment, size_t Observers>
+void TxFlash<Bank0, Bank1, Tracer, Alignment, Observers>::read(void *destination) const {
     position_t length = this->length();
-    return read_chunk(m_read_bank, m_read_position + 1 /* header */ + sizeof(position_t) /* length */, destination, length);
+    return read_chunk(m_read_bank, Format::payload(m_read_position), destination, length);
 }
 
-template<typename Bank0, typename Bank1>
-bool TxFlash<Bank0, Bank1>::write(const void *payload, position_t length) {
-    if (std::min(remaining(Bank::BANK0, 0), remaining(Bank::BANK1, 0)) <
-        1 /* header */ + sizeof(position_t) /* length */ + length /* payload */ + 1 /* next header */) {
-        TXFLASH_DEBUG("Payload exceeds bank size\n");
-        return false;
+template<typename Bank0, typename Bank1, typename Tracer, size_t Alignment, size_t Observers>
+template<typename T>
+const T *TxFlash<Bank0, Bank1, Tracer, Alignment, Observers>::view() const {
+    static_assert(std::is_trivially_copyable<T>::value, "view type is not trivially copyable");
+    static_assert(alignof(T) <= Alignment, "view type alignment exceeds the payload alignment");
+
+    assert(m_initialized && "begin() not called");
+
+    const uint8_t *payload = (m_read_bank == Bank::BANK0 ? m_bank0.data() : m_bank1.data()) + Format::payload(m_read_position);
+
+    if (length() < sizeof(T) || reinterpret_cast<uintptr_t>(payload) % alignof(T))
+        return nullptr;
+    return reinterpret_cast<const T *>(payload);
+}
+
+template<typename Bank0, typename Bank1, typename Tracer, size_t Alignment, size_t Observers>
+bool TxFlash<Bank0, Bank1, Tracer, Alignment, Observers>::write(const void *payload, position_t length) {
+    return write(payload, length, Change::Cause::WRITE);
+}
+
+template<typename Bank0, typename Bank1, typename Tracer, size_t Alignment, size_t Observers>
+bool TxFlash<Bank0, Bank1, Tracer, Alignment, Observers>::write(const void *payload, position_t length, typename Change::Cause cause) {
+    begin();
+    m_tracer.write_begin(length);
+    bool result = append(payload, length, m_reserve);
+    m_record_version += result;
+    m_tracer.write_end(result);
+
+    if (result)
+        notify(cause);
+    return result;
+}
+
+template<typename Bank0, typename Bank1, typename Tracer, size_t Alignment, size_t Observers>
+bool TxFlash<Bank0, Bank1, Tracer, Alignment, Observers>::write_if(uint32_t expected_version, const void *payload, position_t length) {
+    begin();
+    return m_record_version == expected_version && write(payload, length);
+}
+
+template<typename Bank0, typename Bank1, typename Tracer, size_t Alignment, size_t Observers>
+uint32_t TxFlash<Bank0, Bank1, Tracer, Alignment, Observers>::record_version() const {
+    assert(m_initialized && "begin() not called");
+    return m_record_version;
+}
+
+template<typename Bank0, typename Bank1, typename Tracer, size_t Alignment, size_t Observers>
+bool TxFlash<Bank0, Bank1, Tracer, Alignment, Observers>::emergency_write(const void *payload, position_t length) {
+    begin();
+    bool result = true;
+
+    m_tracer.write_begin(length);
+    if (!Format::fits(remaining(m_write_bank, m_write_position), length, write_alignment()) || !program(payload, length))
+        result = append(payload, length, m_reserve);
+    m_record_version += result;
+    m_tracer.write_end(result);
+
+    if (result)
+        notify(Change::Cause::WRITE);
+    return result;
+}
+
+template<typename Bank0, typename Bank1, typename Tracer, size_t Alignment, size_t Observers>
+void TxFlash<Bank0, Bank1, Tracer, Alignment, Observers>::set_reserve(position_t length) {
+    m_reserve = length;
+}
+
+template<typename Bank0, typename Bank1, typename Tracer, size_t Alignment, size_t Observers>
+typename TxFlash<Bank0, Bank1, Tracer, Alignment, Observers>::position_t TxFlash<Bank0, Bank1, Tracer, Alignment, Observers>::free_space() const {
+    assert(m_initialized && "begin() not called");
+    return available(m_write_bank, m_write_position, m_reserve);
+}
+
+template<typename Bank0, typename Bank1, typename Tracer, size_t Alignment, size_t Observers>
+bool TxFlash<Bank0, Bank1, Tracer, Alignment, Observers>::will_switch(position_t length) const {
+    assert(m_initialized && "begin() not called");
+    return !Format::fits(free_space(), length, write_alignment());
+}
+
+template<typename Bank0, typename Bank1, typename Tracer, size_t Alignment, size_t Observers>
+typename TxFlash<Bank0, Bank1, Tracer, Alignment, Observers>::WriteCost TxFlash<Bank0, Bank1, Tracer, Alignment, Observers>::estimated_cost(position_t length) const {
+    assert(m_initialized && "begin() not called");
+    WriteCost cost = {0, 0};
+
+    // Mirror append()
+    if (!Format::fits(std::min(available(Bank::BANK0, 0, m_reserve), available(Bank::BANK1, 0, m_reserve)), length, Alignment))
+        return cost;
+
+    if (will_switch(length))
+        cost.erases = m_write_bank == Bank::BANK0 ? 1 /* bank1 */ : 2 /* bank0, then bank1 */;
+    cost.programmed = Format::size(length, 1 /* no padding */);
+    if (cost.erases || !m_write_position)
+        cost.programmed += 1 /* bank header */;
+    return cost;
+}
+
+template<typename Bank0, typename Bank1, typename Tracer, size_t Alignment, size_t Observers>
+typename TxFlash<Bank0, Bank1, Tracer, Alignment, Observers>::position_t TxFlash<Bank0, Bank1, Tracer, Alignment, Observers>::record_size(position_t length) {
+    return Format::size(length, Alignment);
+}
+
+template<typename Bank0, typename Bank1, typename Tracer, size_t Alignment, size_t Observers>
+bool TxFlash<Bank0, Bank1, Tracer, Alignment, Observers>::program(const void *payload, position_t length) {
+    // Write payload
+    if (!open_record(length) || !write_chunk(m_write_bank, Format::payload(m_write_position), payload, length) ||
+        !commit_record(length))
+        return abandon();
+    return true;
+}
+
+template<typename Bank0, typename Bank1, typename Tracer, size_t Alignment, size_t Observers>
+bool TxFlash<Bank0, Bank1, Tracer, Alignment, Observers>::open_record(position_t length) {
+    // Write bank header, when the bank is erased
+    if (!m_write_position) {
+        Header header = Format::bank_header(Format::version, Alignment);
+        m_version = Format::version;
+        m_alignment = Alignment;
+        m_write_position = Format::first(Format::version, Alignment);
+
+        if (!write_chunk(m_write_bank, 0, &header, 1))
+            return false;
     }
 
-    if (remaining(m_write_bank, m_write_position) >= 1 /* header */ + sizeof(position_t) /* length */ + length /* payload */ + 1 /* next header */) {
-        // Write length
-        write_chunk(m_write_bank, m_write_position + 1 /* header */, &length, sizeof(position_t));
+    // Write length
+    return write_chunk(m_write_bank, m_write_position + 1 /* header */, &length, sizeof(position_t));
+}
+
+template<typename Bank0, typename Bank1, typename Tracer, size_t Alignment, size_t Observers>
+bool TxFlash<Bank0, Bank1, Tracer, Alignment, Observers>::abandon() {
+    // Parsing stops at the torn record, so give up the rest of the bank
+    m_tracer.recovery(Recovery::PROGRAM_FAILED, (uint8_t) m_write_bank, m_write_position);
+    m_write_position = m_write_bank == Bank::BANK0 ? m_bank0.length() : m_bank1.length();
+    return false;
+}
 
-        // Write payload
-        write_chunk(m_write_bank, m_write_position + 1 /* header */ + sizeof(position_t) /* length */, payload, length);
+template<typename Bank0, typename Bank1, typename Tracer, size_t Alignment, size_t Observers>
+bool TxFlash<Bank0, Bank1, Tracer, Alignment, Observers>::commit_record(position_t length) {
+    // Write header
+    Header header = Header::RECORD;
+    if (!write_chunk(m_write_bank, m_write_position, &header, 1))
+        return false;
 
-        // Write header
-        Header header = Header::RECORD;
-        write_chunk(m_write_bank, m_write_position, &header, 1);
+    m_read_bank = m_write_bank;
+    m_read_position = m_write_position;
 
-        m_read_bank = m_write_bank;
-        m_read_position = m_write_position;
+    m_write_position += Format::size(length, m_alignment);
 
-        m_write_position += 1 /* header */ + sizeof(position_t) /* length */ + length /* payload */;
+    cache_cursor();
+    return true;
+}
 
+template<typename Bank0, typename Bank1, typename Tracer, size_t Alignment, size_t Observers>
+bool TxFlash<Bank0, Bank1, Tracer, Alignment, Observers>::append(const void *payload, position_t length, position_t reserve) {
+    if (!Format::fits(std::min(available(Bank::BANK0, 0, reserve), available(Bank::BANK1, 0, reserve)), length, Alignment)) {
+        return false;
+    }
+
+    // A record torn by a program failure is retried on the other bank
+    if (Format::fits(available(m_write_bank, m_write_position, reserve), length, write_alignment()) && program(payload, length))
         return true;
-    } else {
-        Bank target_bank = m_write_bank == Bank::BANK0 ? Bank::BANK1 : Bank::BANK0;
-        m_write_position = 0;
 
-        bool result;
+    return switch_bank([&]() {
+        return program(payload, length);
+    });
+}
 
-        switch (target_bank) {
-            case Bank::BANK1:
-                m_bank1.erase();
-                m_write_bank = Bank::BANK1;
-                result = write(payload, length);
-                break;
+template<typename Bank0, typename Bank1, typename Tracer, size_t Alignment, size_t Observers>
+template<typename Program>
+bool TxFlash<Bank0, Bank1, Tracer, Alignment, Observers>::switch_bank(Program program) {
+    Bank source_bank = m_write_bank, target_bank = m_write_bank == Bank::BANK0 ? Bank::BANK1 : Bank::BANK0;
+    uint8_t version = m_version;
+    position_t alignment = m_alignment, position = m_write_position;
+
+    m_tracer.switch_begin((uint8_t) source_bank, (uint8_t) target_bank);
+
+    // The current configuration stays in the source bank until the new record is committed into the target one
+    erase(target_bank);
+    m_write_bank = target_bank;
+    m_write_position = 0;
+    restart_scrub();
+
+    bool result = program();
+
+    if (result && target_bank == Bank::BANK0) {
+        erase(Bank::BANK1);
+    } else if (!result) {
+        // Erase the torn record, whose header could be partially programmed, and keep appending to the source bank
+        erase(target_bank);
+        m_write_bank = source_bank;
+        m_version = version;
+        m_alignment = alignment;
+        m_write_position = position;
+    }
 
-            case Bank::BANK0:
-                m_bank0.erase();
-                m_write_bank = Bank::BANK0;
-                result = write(payload, length);
-                if (result)
-                    m_bank1.erase();
-                break;
+    m_tracer.switch_end((uint8_t) m_write_bank);
+
+    return result;
+}
+
+template<typename Bank0, typename Bank1, typename Tracer, size_t Alignment, size_t Observers>
+bool TxFlash<Bank0, Bank1, Tracer, Alignment, Observers>::relocate() {
+    Bank source = m_read_bank;
+    position_t position = Format::payload(m_read_position), length = this->length();
+
+    if (!Format::fits(remaining(m_write_bank == Bank::BANK0 ? Bank::BANK1 : Bank::BANK0, 0), length, Alignment))
+        return false;
+
+    // Switch bank as append() does, copying the payload from the current record
+    return switch_bank([&]() {
+        if (!open_record(length))
+            return abandon();
+
+        for (position_t offset = 0; offset < length;) {
+            uint8_t chunk[32];
+            position_t size = std::min<position_t>(sizeof(chunk), length - offset);
+
+            read_chunk(source, position + offset, chunk, size);
+            if (!write_chunk(m_write_bank, Format::payload(m_write_position) + offset, chunk, size))
+                return abandon();
+            offset += size;
         }
+        return commit_record(length) || abandon();
+    });
+}
+
+template<typename Bank0, typename Bank1, typename Tracer, size_t Alignment, size_t Observers>
+typename TxFlash<Bank0, Bank1, Tracer, Alignment, Observers>::Format::Record
+TxFlash<Bank0, Bank1, Tracer, Alignment, Observers>::probe(Bank bank, position_t position) const {
+    return bank == Bank::BANK0 ? Format::probe(m_bank0, position, m_alignment)
+                               : Format::probe(m_bank1, position, m_alignment);
+}
+
+template<typename Bank0, typename Bank1, typename Tracer, size_t Alignment, size_t Observers>
+bool TxFlash<Bank0, Bank1, Tracer, Alignment, Observers>::blank(Bank bank, position_t position, position_t length) const {
+    uint8_t chunk[32];
+
+    for (position_t offset = 0; offset < length;) {
+        position_t size = std::min<position_t>(sizeof(chunk), length - offset);
+
+        read_chunk(bank, position + offset, chunk, size);
+        for (position_t i = 0; i < size; i++)
+            if (chunk[i] != empty_value)
+                return false;
+        offset += size;
+    }
+    return true;
+}
 
-        return result;
+template<typename Bank0, typename Bank1, typename Tracer, size_t Alignment, size_t Observers>
+void TxFlash<Bank0, Bank1, Tracer, Alignment, Observers>::restart_scrub() {
+    m_scrub_phase = ScrubPhase::RECORDS;
+    m_scrub_position = 0;
+}
+
+template<typename Bank0, typename Bank1, typename Tracer, size_t Alignment, size_t Observers>
+typename TxFlash<Bank0, Bank1, Tracer, Alignment, Observers>::Health
+TxFlash<Bank0, Bank1, Tracer, Alignment, Observers>::damage(Recovery reason, Bank bank, position_t position, bool repairable) {
+    m_tracer.recovery(reason, (uint8_t) bank, position);
+    restart_scrub();
+
+    if (bank != m_write_bank) {
+        // The standby bank holds no configuration
+        erase(bank);
+        return Health::REPAIRED;
     }
+    if (!repairable || !relocate())
+        return Health::DAMAGED;
+
+    // Views of the configuration moved along with it
+    notify(Change::Cause::RELOCATION);
+    return Health::REPAIRED;
+}
+
+template<typename Bank0, typename Bank1, typename Tracer, size_t Alignment, size_t Observers>
+typename TxFlash<Bank0, Bank1, Tracer, Alignment, Observers>::Health TxFlash<Bank0, Bank1, Tracer, Alignment, Observers>::scrub_step(position_t length) {
+    begin();
+
+    const Bank standby = m_write_bank == Bank::BANK0 ? Bank::BANK1 : Bank::BANK0;
+    const position_t bank_length = m_write_bank == Bank::BANK0 ? m_bank0.length() : m_bank1.length();
+    position_t spent = 0;
+
+    do {
+        switch (m_scrub_phase) {
+            case ScrubPhase::RECORDS: {
+                if (m_scrub_position >= m_write_position) {
+                    m_scrub_phase = ScrubPhase::FREE;
+                    break;
+                }
+
+                if (!m_scrub_position && m_version) {
+                    Header header = m_write_bank == Bank::BANK0 ? Format::header(m_bank0, 0) : Format::header(m_bank1, 0);
+                    if (header != Format::bank_header(m_version, m_alignment))
+                        return damage(Recovery::BANK_HEADER, m_write_bank, 0, true);
+
+                    m_scrub_position = Format::first(m_version, m_alignment);
+                    spent += 1;
+                    break;
+                }
+
+                position_t position = m_scrub_position;
+                typename Format::Record record = probe(m_write_bank, position);
+                spent += 1 /* header */ + sizeof(position_t) /* length */;
+
+                // A torn record after the current one gives up the rest of the bank, before it the chain is broken
+                if (record.status == Format::Status::TORN && m_write_position == bank_length && position > m_read_position) {
+                    m_scrub_phase = ScrubPhase::STANDBY;
+                    m_scrub_position = 0;
+                    break;
+                }
+
+                switch (record.status) {
+                    case Format::Status::VALID:
+                        break;
+                    case Format::Status::OPEN:
+                        return damage(Recovery::OPEN_RECORD, m_write_bank, position, position < m_read_position);
+                    case Format::Status::TORN:
+                        return damage(Recovery::TORN_RECORD, m_write_bank, position, position < m_read_position);
+                    case Format::Status::BAD_LENGTH:
+                        return damage(Recovery::RECORD_LENGTH, m_write_bank, position, position < m_read_position);
+                    default:
+                        return damage(Recovery::RECORD_HEADER, m_write_bank, position, position < m_read_position);
+                }
+
+                // The current record must end where the next one will be written
+                position_t end = position + Format::size(record.length, m_alignment), padding = Format::payload(position) + record.length;
+                if (end > m_write_position || (position == m_read_position && end != m_write_position && m_write_position != bank_length))
+                    return damage(Recovery::RECORD_LENGTH, m_write_bank, position, position < m_read_position);
+
+                if (!blank(m_write_bank, padding, end - padding))
+                    return damage(Recovery::DIRTY_SPACE, m_write_bank, padding, true);
+
+                spent += end - padding;
+                m_scrub_position = end;
+                break;
+            }
+
+            case ScrubPhase::FREE: {
+                // Records appended meanwhile are checked by the next pass
+                m_scrub_position = std::max(m_scrub_position, m_write_position);
+                if (m_scrub_position >= bank_length) {
+                    m_scrub_phase = ScrubPhase::STANDBY;
+                    m_scrub_position = 0;
+                    break;
+                }
+
+                position_t size = std::min<position_t>(32, bank_length - m_scrub_position);
+                if (!blank(m_write_bank, m_scrub_position, size))
+                    return damage(Recovery::DIRTY_SPACE, m_write_bank, m_scrub_position, true);
+
+                spent += size;
+                m_scrub_position += size;
+                break;
+            }
+
+            case ScrubPhase::STANDBY: {
+                if (standby == Bank::BANK0) {
+                    // Bank0 keeps the records preceding the switch to bank1 until the next switch, but must not look newer
+                    uint8_t version = Format::bank_version(m_bank0);
+                    position_t first = version > Format::version ? m_bank0.length() : Format::first(version, Format::bank_alignment(m_bank0));
+                    Header header = first < m_bank0.length() ? Format::header(m_bank0, first) : Header::SWITCH;
+                    if (header != Header::EMPTY && header != Header::RECORD)
+                        return damage(Recovery::BANK_HEADER, standby, 0, true);
+
+                    restart_scrub();
+                    return Health::HEALTHY;
+                }
+
+                // Bank1 is erased by every switch to bank0, so programmed bytes mean a failed erase or disturbed cells
+                if (m_scrub_position >= m_bank1.length()) {
+                    restart_scrub();
+                    return Health::HEALTHY;
+                }
+
+                position_t size = std::min<position_t>(32, m_bank1.length() - m_scrub_position);
+                if (!blank(standby, m_scrub_position, size))
+                    return damage(Recovery::DIRTY_SPACE, standby, m_scrub_position, true);
+
+                spent += size;
+                m_scrub_position += size;
+                break;
+            }
+        }
+    } while (spent < length);
+
+    return Health::SCRUBBING;
 }
 
-template<typename Bank0, typename Bank1>
-void TxFlash<Bank0, Bank1>::reset() {
-    TXFLASH_DEBUG("Resetting flash to default value\n");
+template<typename Bank0, typename Bank1, typename Tracer, size_t Alignment, size_t Observers>
+uint8_t TxFlash<Bank0, Bank1, Tracer, Alignment, Observers>::format_version() const {
+    assert(m_initialized && "begin() not called");
+    return m_version;
+}
+
+template<typename Bank0, typename Bank1, typename Tracer, size_t Alignment, size_t Observers>
+void TxFlash<Bank0, Bank1, Tracer, Alignment, Observers>::reset() {
+    write(m_default_payload, m_default_payload_length, Change::Cause::RESET);
+}
 
-    m_bank0.erase();
-    m_bank1.erase();
+template<typename Bank0, typename Bank1, typename Tracer, size_t Alignment, size_t Observers>
+void TxFlash<Bank0, Bank1, Tracer, Alignment, Observers>::recover() {
+    erase(Bank::BANK0);
+    erase(Bank::BANK1);
 
     m_read_bank = m_write_bank = Bank::BANK0;
     m_read_position = m_write_position = 0;
+    restart_scrub();
+
+    write(m_default_payload, m_default_payload_length, Change::Cause::RECOVERY);
+}
+
+template<typename Bank0, typename Bank1, typename Tracer, size_t Alignment, size_t Observers>
+bool TxFlash<Bank0, Bank1, Tracer, Alignment, Observers>::subscribe(observer_t observer, void *context) {
+    return m_observers.add(observer, context);
+}
 
-    write(m_default_payload, m_default_payload_length);
+template<typename Bank0, typename Bank1, typename Tracer, size_t Alignment, size_t Observers>
+bool TxFlash<Bank0, Bank1, Tracer, Alignment, Observers>::unsubscribe(observer_t observer, void *context) {
+    return m_observers.remove(observer, context);
+}
+
+template<typename Bank0, typename Bank1, typename Tracer, size_t Alignment, size_t Observers>
+void TxFlash<Bank0, Bank1, Tracer, Alignment, Observers>::notify(typename Change::Cause cause) {
+    using memory_mapped = std::integral_constant<bool, is_memory_mapped<Bank0>::value && is_memory_mapped<Bank1>::value>;
+
+    // Spare the length read when nobody listens
+    if (m_observers.empty())
+        return;
+
+    Change change = {cause, m_record_version, length(), in_place(memory_mapped())};
+    m_observers.notify(change);
+}
+
+template<typename Bank0, typename Bank1, typename Tracer, size_t Alignment, size_t Observers>
+const void *TxFlash<Bank0, Bank1, Tracer, Alignment, Observers>::in_place(std::true_type) const {
+    return (m_read_bank == Bank::BANK0 ? m_bank0.data() : m_bank1.data()) + Format::payload(m_read_position);
+}
+
+template<typename Bank0, typename Bank1, typename Tracer, size_t Alignment, size_t Observers>
+const void *TxFlash<Bank0, Bank1, Tracer, Alignment, Observers>::in_place(std::false_type) const {
+    return nullptr;
+}
+
+template<typename Bank0, typename Bank1, typename Tracer, size_t Alignment, size_t Observers>
+Tracer &TxFlash<Bank0, Bank1, Tracer, Alignment, Observers>::tracer() {
+    return m_tracer;
 }
 
 /**
  * Factory function to instance a TxFlash.
  *
+ * \tparam Tracer Tracer policy (defaults to NullTracer)
+ * \tparam Alignment Payload alignment (defaults to 1)
+ * \tparam Observers Observer capacity (defaults to 0)
  * \tparam Bank0 Bank0 type
  * \tparam Bank1 Bank1 type
  * \param bank0 Bank0 implementation
@@ -332,10 +1055,13 @@ void TxFlash<Bank0, Bank1>::reset() {
  * \param default_length Default payload length
  * \return
  */
-template<typename Bank0, typename Bank1>
+template<typename Tracer = NullTracer, size_t Alignment = 1, size_t Observers = 0, typename Bank0, typename Bank1>
 TxFlash<
         typename std::remove_reference<Bank0>::type,
-        typename std::remove_reference<Bank1>::type
+        typename std::remove_reference<Bank1>::type,
+        Tracer,
+        Alignment,
+        Observers
 > make_txflash(Bank0 &&bank0, Bank1 &&bank1, const void *default_payload,
                typename std::common_type<
                        typename std::remove_reference<Bank0>::type::position_t,
@@ -344,7 +1070,10 @@ TxFlash<
 ) {
     return TxFlash<
             typename std::remove_reference<Bank0>::type,
-            typename std::remove_reference<Bank1>::type
+            typename std::remove_reference<Bank1>::type,
+            Tracer,
+            Alignment,
+            Observers
     >(
             std::forward<Bank0>(bank0),
             std::forward<Bank1>(bank1),
@@ -353,6 +1082,49 @@ TxFlash<
     );
 }
 
+/**
+ * Factory function to instance a TxFlash, deferring flash parsing (see defer_init).
+ *
+ * \tparam Tracer Tracer policy (defaults to NullTracer)
+ * \tparam Alignment Payload alignment (defaults to 1)
+ * \tparam Observers Observer capacity (defaults to 0)
+ * \tparam Bank0 Bank0 type
+ * \tparam Bank1 Bank1 type
+ * \param bank0 Bank0 implementation
+ * \param bank1 Bank1 implementation
+ * \param default_payload Default payload
+ * \param default_length Default payload length
+ * \param defer Deferred initialization tag
+ * \return
+ */
+template<typename Tracer = NullTracer, size_t Alignment = 1, size_t Observers = 0, typename Bank0, typename Bank1>
+TxFlash<
+        typename std::remove_reference<Bank0>::type,
+        typename std::remove_reference<Bank1>::type,
+        Tracer,
+        Alignment,
+        Observers
+> make_txflash(Bank0 &&bank0, Bank1 &&bank1, const void *default_payload,
+               typename std::common_type<
+                       typename std::remove_reference<Bank0>::type::position_t,
+                       typename std::remove_reference<Bank1>::type::position_t
+               >::type default_length,
+               DeferInit defer
+) {
+    return TxFlash<
+            typename std::remove_reference<Bank0>::type,
+            typename std::remove_reference<Bank1>::type,
+            Tracer,
+            Alignment,
+            Observers
+    >(
+            std::forward<Bank0>(bank0),
+            std::forward<Bank1>(bank1),
+            default_payload,
+            default_length,
+            defer
+    );
+}
 }
 
 #endif //TXFLASH_HH
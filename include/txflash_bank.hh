@@ -0,0 +1,62 @@
+#ifndef TXFLASH_BANK_HH
+#define TXFLASH_BANK_HH
+
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+
+namespace txflash {
+
+/**
+ * Detects banks exposing their memory mapped content through a const uint8_t *data() const method.
+ */
+template<typename Bank, typename = void>
+struct is_memory_mapped : std::false_type {
+};
+
+template<typename Bank>
+struct is_memory_mapped<Bank, typename std::enable_if<
+        std::is_same<decltype(std::declval<const Bank &>().data()), const uint8_t *>::value
+>::type> : std::true_type {
+};
+
+/**
+ * Detects banks reporting program failures, ie. whose write_chunk() returns bool (false when the chunk could not be
+ * programmed, eg. on a worn out cell). Banks whose write_chunk() returns void are assumed to never fail.
+ */
+template<typename Bank>
+struct reports_program_status : std::is_same<decltype(std::declval<Bank &>().write_chunk(
+        std::declval<typename Bank::position_t>(), std::declval<const void *>(), std::declval<typename Bank::position_t>()
+)), bool> {
+};
+
+template<typename Bank>
+bool program_chunk(Bank &bank, typename Bank::position_t position, const void *payload,
+                   typename Bank::position_t length, std::true_type) {
+    return bank.write_chunk(position, payload, length);
+}
+
+template<typename Bank>
+bool program_chunk(Bank &bank, typename Bank::position_t position, const void *payload,
+                   typename Bank::position_t length, std::false_type) {
+    bank.write_chunk(position, payload, length);
+    return true;
+}
+
+/**
+ * Program a chunk into a bank.
+ *
+ * \param bank Bank
+ * \param position Chunk position
+ * \param payload Chunk content
+ * \param length Chunk length
+ * \return False if the bank reported a program failure (see reports_program_status)
+ */
+template<typename Bank>
+bool program_chunk(Bank &bank, typename Bank::position_t position, const void *payload, typename Bank::position_t length) {
+    return program_chunk(bank, position, payload, length, reports_program_status<Bank>());
+}
+
+}
+
+#endif //TXFLASH_BANK_HH
@@ -0,0 +1,159 @@
+#ifndef TXFLASH_BLANK_HH
+#define TXFLASH_BLANK_HH
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <utility>
+
+#include "txflash_bank.hh"
+
+namespace txflash {
+
+/**
+ * Tell whether a memory area only holds the given value. Bytes are compared a machine word at a time once aligned.
+ *
+ * \param data Memory area
+ * \param length Memory area length
+ * \param value Expected value
+ * \return True if every byte equals value
+ */
+inline bool is_blank(const uint8_t *data, size_t length, uint8_t value) {
+    const uintptr_t pattern = (uintptr_t) -1 / 0xff * value;
+
+    for (; length && (uintptr_t) data % sizeof(uintptr_t); data++, length--)
+        if (*data != value)
+            return false;
+
+    for (; length >= sizeof(uintptr_t); data += sizeof(uintptr_t), length -= sizeof(uintptr_t)) {
+        uintptr_t word;
+        memcpy(&word, data, sizeof(uintptr_t));
+        if (word != pattern)
+            return false;
+    }
+
+    for (; length; data++, length--)
+        if (*data != value)
+            return false;
+
+    return true;
+}
+
+/**
+ * Bank wrapper skipping erases of banks already reading as empty_value, saving the erase time and an endurance cycle
+ * (eg. on a fresh unit or when switching to a bank erased by a previous reset). Memory mapped banks (see
+ * is_memory_mapped) are blank-checked in place with is_blank(), other banks through chunked reads. The wrapper is
+ * memory mapped whenever the wrapped bank is, so that TxFlash::view() keeps working through it.
+ *
+ * \tparam Bank Wrapped bank type
+ * \tparam ChunkLength Read length used to blank-check banks not memory mapped
+ *
+ * @author Andrea Leofreddi
+ */
+template<typename Bank, size_t ChunkLength = 32>
+class BlankCheckFlashBank {
+public:
+    static const uint8_t empty_value = Bank::empty_value;
+    using position_t = typename Bank::position_t;
+
+    /**
+     * Initialize the blank checking bank.
+     *
+     * \param bank Wrapped bank, which will be moved into a private field
+     */
+    explicit BlankCheckFlashBank(Bank &&bank);
+
+    position_t length() const;
+
+    /**
+     * Memory mapped content of the wrapped bank, only available when the wrapped bank is memory mapped.
+     *
+     * \return Bank content
+     */
+    template<typename B = Bank, typename = typename std::enable_if<is_memory_mapped<B>::value>::type>
+    const uint8_t *data() const;
+
+    /**
+     * Tell whether the whole bank reads as empty_value.
+     *
+     * \return True if the bank is blank
+     */
+    bool blank() const;
+
+    /**
+     * Erase the bank, unless already blank.
+     */
+    void erase();
+
+    void read_chunk(position_t position, void *destination, position_t length) const;
+
+    bool write_chunk(position_t position, const void *payload, position_t length);
+
+private:
+    Bank m_bank;
+
+    bool blank(std::true_type) const;
+
+    bool blank(std::false_type) const;
+};
+
+template<typename Bank, size_t ChunkLength>
+BlankCheckFlashBank<Bank, ChunkLength>::BlankCheckFlashBank(Bank &&bank) : m_bank(std::move(bank)) {
+}
+
+template<typename Bank, size_t ChunkLength>
+typename BlankCheckFlashBank<Bank, ChunkLength>::position_t BlankCheckFlashBank<Bank, ChunkLength>::length() const {
+    return m_bank.length();
+}
+
+template<typename Bank, size_t ChunkLength>
+template<typename B, typename>
+const uint8_t *BlankCheckFlashBank<Bank, ChunkLength>::data() const {
+    return m_bank.data();
+}
+
+template<typename Bank, size_t ChunkLength>
+bool BlankCheckFlashBank<Bank, ChunkLength>::blank() const {
+    return blank(is_memory_mapped<Bank>());
+}
+
+template<typename Bank, size_t ChunkLength>
+bool BlankCheckFlashBank<Bank, ChunkLength>::blank(std::true_type) const {
+    return is_blank(m_bank.data(), m_bank.length(), empty_value);
+}
+
+template<typename Bank, size_t ChunkLength>
+bool BlankCheckFlashBank<Bank, ChunkLength>::blank(std::false_type) const {
+    uint8_t chunk[ChunkLength];
+
+    for (position_t position = 0, length = m_bank.length(), size; position < length; position += size) {
+        size = std::min<position_t>(ChunkLength, length - position);
+
+        m_bank.read_chunk(position, chunk, size);
+        if (!is_blank(chunk, size, empty_value))
+            return false;
+    }
+    return true;
+}
+
+template<typename Bank, size_t ChunkLength>
+void BlankCheckFlashBank<Bank, ChunkLength>::erase() {
+    if (!blank())
+        m_bank.erase();
+}
+
+template<typename Bank, size_t ChunkLength>
+void BlankCheckFlashBank<Bank, ChunkLength>::read_chunk(position_t position, void *destination, position_t length) const {
+    m_bank.read_chunk(position, destination, length);
+}
+
+template<typename Bank, size_t ChunkLength>
+bool BlankCheckFlashBank<Bank, ChunkLength>::write_chunk(position_t position, const void *payload, position_t length) {
+    return program_chunk(m_bank, position, payload, length);
+}
+
+}
+
+#endif //TXFLASH_BLANK_HH
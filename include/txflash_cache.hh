@@ -0,0 +1,146 @@
+#ifndef TXFLASH_CACHE_HH
+#define TXFLASH_CACHE_HH
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+
+#include "txflash_bank.hh"
+
+namespace txflash {
+
+/**
+ * Bank wrapper serving reads from a small read-through cache of Blocks blocks of BlockSize bytes, so that scanning
+ * records (a header and a length per record) costs a few block transfers instead of many tiny reads. This is useful on
+ * banks with a high per-read cost (eg. external SPI flash).
+ *
+ * Blocks are replaced round-robin. Writes and erases invalidate the affected blocks, and reads spanning whole blocks
+ * bypass the cache.
+ *
+ * The cached bank is not memory mapped (see is_memory_mapped), even when the wrapped bank is: banks worth caching are
+ * not, and those which are need no cache. Hence TxFlash::view() is not available through it, and notified changes carry
+ * no payload.
+ *
+ * \tparam Bank Wrapped bank type
+ * \tparam BlockSize Block size in bytes
+ * \tparam Blocks Number of cached blocks
+ *
+ * @author Andrea Leofreddi
+ */
+template<typename Bank, size_t BlockSize = 64, size_t Blocks = 2>
+class CachedFlashBank {
+public:
+    static const uint8_t empty_value = Bank::empty_value;
+    using position_t = typename Bank::position_t;
+
+    static_assert(BlockSize > 0 && Blocks > 0, "empty cache");
+
+    /**
+     * Initialize the cached bank.
+     *
+     * \param bank Wrapped bank, which will be moved into a private field
+     */
+    explicit CachedFlashBank(Bank &&bank);
+
+    position_t length() const;
+
+    void erase();
+
+    void read_chunk(position_t position, void *destination, position_t length) const;
+
+    bool write_chunk(position_t position, const void *payload, position_t length);
+
+private:
+    // Tag of an invalid block, which can't be the base of a block of the bank
+    static const position_t invalid = (position_t) -1;
+
+    Bank m_bank;
+
+    mutable uint8_t m_data[Blocks][BlockSize];
+    mutable position_t m_tags[Blocks];
+    mutable size_t m_next;
+
+    const uint8_t *fetch(position_t base) const;
+
+    void clear();
+
+    void invalidate(position_t position, position_t length);
+};
+
+template<typename Bank, size_t BlockSize, size_t Blocks>
+CachedFlashBank<Bank, BlockSize, Blocks>::CachedFlashBank(Bank &&bank) : m_bank(std::move(bank)), m_next(0) {
+    clear();
+}
+
+template<typename Bank, size_t BlockSize, size_t Blocks>
+typename CachedFlashBank<Bank, BlockSize, Blocks>::position_t CachedFlashBank<Bank, BlockSize, Blocks>::length() const {
+    return m_bank.length();
+}
+
+template<typename Bank, size_t BlockSize, size_t Blocks>
+const uint8_t *CachedFlashBank<Bank, BlockSize, Blocks>::fetch(position_t base) const {
+    for (size_t i = 0; i < Blocks; i++)
+        if (m_tags[i] == base)
+            return m_data[i];
+
+    size_t victim = m_next;
+    position_t remaining = m_bank.length() - base;
+
+    m_next = (m_next + 1) % Blocks;
+    m_bank.read_chunk(base, m_data[victim], remaining < BlockSize ? remaining : (position_t) BlockSize);
+    m_tags[victim] = base;
+
+    return m_data[victim];
+}
+
+template<typename Bank, size_t BlockSize, size_t Blocks>
+void CachedFlashBank<Bank, BlockSize, Blocks>::clear() {
+    for (size_t i = 0; i < Blocks; i++)
+        m_tags[i] = invalid;
+}
+
+template<typename Bank, size_t BlockSize, size_t Blocks>
+void CachedFlashBank<Bank, BlockSize, Blocks>::invalidate(position_t position, position_t length) {
+    for (size_t i = 0; i < Blocks; i++)
+        if (m_tags[i] != invalid && m_tags[i] + BlockSize > position && m_tags[i] < position + length)
+            m_tags[i] = invalid;
+}
+
+template<typename Bank, size_t BlockSize, size_t Blocks>
+void CachedFlashBank<Bank, BlockSize, Blocks>::erase() {
+    clear();
+    m_bank.erase();
+}
+
+template<typename Bank, size_t BlockSize, size_t Blocks>
+void CachedFlashBank<Bank, BlockSize, Blocks>::read_chunk(position_t position, void *destination, position_t length) const {
+    uint8_t *write = (uint8_t *) destination;
+
+    while (length) {
+        position_t offset = position % BlockSize, size;
+
+        if (!offset && length >= BlockSize) {
+            // Whole blocks are read directly
+            size = length - length % BlockSize;
+            m_bank.read_chunk(position, write, size);
+        } else {
+            size = BlockSize - offset < length ? BlockSize - offset : length;
+            memcpy(write, fetch(position - offset) + offset, size);
+        }
+
+        position += size;
+        write += size;
+        length -= size;
+    }
+}
+
+template<typename Bank, size_t BlockSize, size_t Blocks>
+bool CachedFlashBank<Bank, BlockSize, Blocks>::write_chunk(position_t position, const void *payload, position_t length) {
+    invalidate(position, length);
+    return program_chunk(m_bank, position, payload, length);
+}
+
+}
+
+#endif //TXFLASH_CACHE_HH
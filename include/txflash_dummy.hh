@@ -13,13 +13,16 @@ namespace txflash {
  *
  * This type is a move-only one.
  *
+ * \tparam EmptyValue Value of erased bytes
+ * \tparam Position Position type, bounding the bank length
+ *
  * @author Andrea Leofreddi
  */
-template<uint8_t EmptyValue = 0xff>
+template<uint8_t EmptyValue = 0xff, typename Position = uint16_t>
 class DummyFlashBank {
 public:
     static const uint8_t empty_value = EmptyValue;
-    using position_t = uint16_t;
+    using position_t = Position;
 
     DummyFlashBank(uint8_t *data, size_t length);
 
@@ -27,6 +30,8 @@ public:
 
     position_t length() const;
 
+    const uint8_t *data() const;
+
     virtual void erase();
 
     virtual void read_chunk(position_t position, void *destination, position_t length) const;
@@ -35,33 +40,38 @@ public:
 
 private:
     uint8_t const *m_flash;
-    const uint16_t m_length;
+    const position_t m_length;
 };
 
-template<uint8_t EmptyValue>
-DummyFlashBank<EmptyValue>::DummyFlashBank(uint8_t *data, size_t length)
+template<uint8_t EmptyValue, typename Position>
+DummyFlashBank<EmptyValue, Position>::DummyFlashBank(uint8_t *data, size_t length)
         :m_flash(data), m_length(length) {
 }
 
-template<uint8_t EmptyValue>
-typename DummyFlashBank<EmptyValue>::position_t DummyFlashBank<EmptyValue>::length() const {
+template<uint8_t EmptyValue, typename Position>
+typename DummyFlashBank<EmptyValue, Position>::position_t DummyFlashBank<EmptyValue, Position>::length() const {
     return m_length;
 }
 
-template<uint8_t EmptyValue>
-void DummyFlashBank<EmptyValue>::erase() {
+template<uint8_t EmptyValue, typename Position>
+const uint8_t *DummyFlashBank<EmptyValue, Position>::data() const {
+    return m_flash;
+}
+
+template<uint8_t EmptyValue, typename Position>
+void DummyFlashBank<EmptyValue, Position>::erase() {
     memset((void *) m_flash, EmptyValue, length());
 };
 
-template<uint8_t EmptyValue>
-void DummyFlashBank<EmptyValue>::read_chunk(typename DummyFlashBank<EmptyValue>::position_t position, void *destination,
-                                            typename DummyFlashBank<EmptyValue>::position_t length) const {
+template<uint8_t EmptyValue, typename Position>
+void DummyFlashBank<EmptyValue, Position>::read_chunk(typename DummyFlashBank<EmptyValue, Position>::position_t position, void *destination,
+                                                      typename DummyFlashBank<EmptyValue, Position>::position_t length) const {
     memcpy(destination, m_flash + position, length);
 };
 
-template<uint8_t EmptyValue>
-void DummyFlashBank<EmptyValue>::write_chunk(typename DummyFlashBank<EmptyValue>::position_t position, const void *payload,
-                                             typename DummyFlashBank<EmptyValue>::position_t length) {
+template<uint8_t EmptyValue, typename Position>
+void DummyFlashBank<EmptyValue, Position>::write_chunk(typename DummyFlashBank<EmptyValue, Position>::position_t position, const void *payload,
+                                                       typename DummyFlashBank<EmptyValue, Position>::position_t length) {
     memcpy((void *) (m_flash + position), payload, length);
 };
 
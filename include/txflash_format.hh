@@ -0,0 +1,608 @@
+#ifndef TXFLASH_FORMAT_HH
+#define TXFLASH_FORMAT_HH
+
+#include <algorithm>
+#include <cstdint>
+
+#include "txflash_tracer.hh"
+
+namespace txflash {
+
+/**
+ * TxFlash on-flash record format. Each bank holds a sequence of records, each made of a header byte, the payload length
+ * and the payload itself. Records are committed by programming the header last, so an empty header marks the end of
+ * the sequence. The newest record is the last one of bank1 when both banks hold records (as a switch to bank0 erases
+ * bank1 once completed), else the last one of the non-empty bank.
+ *
+ * Banks start with a bank header byte encoding the format version and the alignment of their records, programmed along
+ * with the first record after an erase. Banks written before versioning start directly with a record and are read as
+ * version 0, so a bank keeps its format until the next bank switch rewrites the newest record in the current one.
+ *
+ * Records of aligned banks are padded to a multiple of the alignment, and the first one is placed so that payloads
+ * start on an alignment boundary (relative to the bank start). Padding is left erased.
+ *
+ * This class holds only parsing code, so that read-only users (eg. inspection tools and bootloaders) can share it
+ * without instancing any write path.
+ *
+ * \tparam EmptyValue Value of erased bytes
+ * \tparam Position Position type, which is also the type of the stored length
+ *
+ * @author Andrea Leofreddi
+ */
+template<uint8_t EmptyValue, typename Position>
+class RecordFormat {
+public:
+    using position_t = Position;
+
+    /**
+     * Current format version, programmed into erased banks.
+     */
+    static const uint8_t version = 1;
+
+    /**
+     * Largest supported record alignment.
+     */
+    static const position_t max_alignment = 64;
+
+    enum class Header : uint8_t {
+        EMPTY = EmptyValue,
+        RECORD = (uint8_t) ((uint16_t) EmptyValue + 1),
+        SWITCH = (uint8_t) ((uint16_t) EmptyValue + 2)
+    };
+
+    enum class State : uint8_t {
+        EMPTY = 0,
+        VALID = 1,
+        INVALID = 2
+    };
+
+    /**
+     * Outcome of probing a record.
+     */
+    enum class Status : uint8_t {
+        VALID,      ///< Valid record
+        END,        ///< Empty header, no more records
+        TORN,       ///< Empty header followed by a partially programmed record, or last header partially programmed
+        OPEN,       ///< Record truncated by the end of the bank
+        BAD_LENGTH, ///< Record length exceeding the bank
+        BAD_HEADER  ///< Unexpected header
+    };
+
+    struct Record {
+        Status status;
+        position_t position;
+        position_t length;
+    };
+
+    /**
+     * Position of the newest record and of the next one to be written.
+     */
+    struct Cursor {
+        uint8_t bank;
+        uint8_t version;
+        position_t alignment;
+        position_t read_position;
+        position_t write_position;
+    };
+
+    /**
+     * Compute the bank header of the given format version and record alignment.
+     *
+     * \param version Format version, at least 1
+     * \param alignment Record alignment, a power of 2 up to max_alignment
+     * \return Bank header
+     */
+    static Header bank_header(uint8_t version, position_t alignment = 1);
+
+    /**
+     * Compute the position of the first record of a bank.
+     *
+     * \param version Bank format version
+     * \param alignment Bank record alignment
+     * \return First record position
+     */
+    static position_t first(uint8_t version, position_t alignment = 1);
+
+    /**
+     * Compute the flash space taken by a record.
+     *
+     * \param length Payload length
+     * \param alignment Bank record alignment
+     * \return Record size
+     */
+    static position_t size(position_t length, position_t alignment = 1);
+
+    /**
+     * Compute the payload position of a record.
+     *
+     * \param position Record position
+     * \return Payload position
+     */
+    static position_t payload(position_t position);
+
+    /**
+     * Tell whether a record fits the given space, still leaving room for the next header. Unlike comparing against
+     * size(), this never overflows position_t.
+     *
+     * \param remaining Available space
+     * \param length Payload length
+     * \param alignment Bank record alignment
+     * \return True if the record fits
+     */
+    static bool fits(position_t remaining, position_t length, position_t alignment = 1);
+
+    /**
+     * Read the header at the given position.
+     */
+    template<typename Bank>
+    static Header header(const Bank &bank, position_t position);
+
+    /**
+     * Read the format version of a bank, 0 when the bank has no bank header (eg. it's empty or predates versioning).
+     * Versions newer than the current one are returned as such, and must be treated as corruption.
+     */
+    template<typename Bank>
+    static uint8_t bank_version(const Bank &bank);
+
+    /**
+     * Read the record alignment of a bank, 1 when the bank has no bank header.
+     */
+    template<typename Bank>
+    static position_t bank_alignment(const Bank &bank);
+
+    /**
+     * Read the payload length of the record at the given position.
+     */
+    template<typename Bank>
+    static position_t length(const Bank &bank, position_t position);
+
+    /**
+     * Tell whether the record at the given position, whose header is empty, has been partially programmed. As the
+     * length is programmed before the payload, checking it is enough.
+     */
+    template<typename Bank>
+    static bool torn(const Bank &bank, position_t position);
+
+    /**
+     * Tell whether the record at the given position, whose header is neither empty nor a record one, had its header
+     * partially programmed (eg. by a failed commit). As the header is programmed last, such a record must be followed
+     * by erased space.
+     */
+    template<typename Bank>
+    static bool torn_header(const Bank &bank, position_t position, position_t alignment);
+
+    /**
+     * Tell whether the bank header, whose version is unknown, has been partially programmed (eg. by a failed program
+     * opening the bank). As the bank header is programmed before the first record, the rest of the bank must be
+     * erased up to the first record length.
+     */
+    template<typename Bank>
+    static bool torn_bank_header(const Bank &bank);
+
+    /**
+     * Probe the record at the given position.
+     *
+     * \param bank Bank
+     * \param position Record position
+     * \param alignment Bank record alignment
+     * \return Probed record
+     */
+    template<typename Bank>
+    static Record probe(const Bank &bank, position_t position, position_t alignment = 1);
+
+    /**
+     * Locate the newest record, reporting visited records and corruptions to the tracer.
+     *
+     * \param bank0 1st bank
+     * \param bank1 2nd bank
+     * \param cursor Destination cursor
+     * \param tracer Tracer
+     * \return Flash state
+     */
+    template<typename Bank0, typename Bank1, typename Tracer>
+    static State locate(const Bank0 &bank0, const Bank1 &bank1, Cursor &cursor, Tracer &tracer);
+
+    /**
+     * Tell whether a cursor, as found by locate() (eg. before a warm reset), still points to the newest record. Only
+     * bank headers and the records around the tail are read, so this is much cheaper than locate() on filled banks.
+     * Payloads can look like records though, so flash rewritten since the cursor was found may match too: compare a
+     * digest() taken along with the cursor to tell.
+     *
+     * \param bank0 1st bank
+     * \param bank1 2nd bank
+     * \param cursor Cursor to check
+     * \return True if the cursor is consistent with the banks content
+     */
+    template<typename Bank0, typename Bank1>
+    static bool matches(const Bank0 &bank0, const Bank1 &bank1, const Cursor &cursor);
+
+    /**
+     * Compute a digest of the flash content a cursor matching the banks (see matches()) relies on: the first record
+     * header and length, and the whole record at the read position. Kept along with a cursor, it tells flash still
+     * holding the same records from flash rewritten meanwhile (eg. reprovisioned by another image), whose payloads
+     * can look like records at the cursor positions.
+     *
+     * \param bank0 1st bank
+     * \param bank1 2nd bank
+     * \param cursor Cursor, matching the banks
+     * \return Digest
+     */
+    template<typename Bank0, typename Bank1>
+    static uint32_t digest(const Bank0 &bank0, const Bank1 &bank1, const Cursor &cursor);
+
+private:
+    template<typename Bank>
+    static bool matches_tail(const Bank &bank, const Cursor &cursor);
+
+    template<typename Bank>
+    static uint32_t digest(const Bank &bank, const Cursor &cursor);
+
+    template<typename Bank>
+    static uint32_t digest(const Bank &bank, position_t position, position_t length, uint32_t hash);
+
+    template<typename Bank>
+    static Header first_header(const Bank &bank);
+    template<typename Bank, typename Tracer>
+    static State fast_forward(const Bank &bank, uint8_t id, uint8_t version, position_t alignment, Cursor &cursor,
+                              Tracer &tracer);
+
+    static const position_t overhead = 1 /* header */ + sizeof(position_t) /* length */;
+
+    static position_t padding(position_t size, position_t alignment);
+};
+
+template<uint8_t EmptyValue, typename Position>
+const uint8_t RecordFormat<EmptyValue, Position>::version;
+
+template<uint8_t EmptyValue, typename Position>
+const typename RecordFormat<EmptyValue, Position>::position_t RecordFormat<EmptyValue, Position>::max_alignment;
+
+template<uint8_t EmptyValue, typename Position>
+const typename RecordFormat<EmptyValue, Position>::position_t RecordFormat<EmptyValue, Position>::overhead;
+
+template<uint8_t EmptyValue, typename Position>
+typename RecordFormat<EmptyValue, Position>::Header RecordFormat<EmptyValue, Position>::bank_header(uint8_t version, position_t alignment) {
+    uint8_t shift = 0;
+    while ((position_t) 1 << shift < alignment)
+        shift++;
+
+    // Version in the low nibble and alignment shift above it, past SWITCH so that a bank header is never mistaken for a record
+    return (Header) (uint8_t) ((uint16_t) Header::SWITCH + (version | shift << 4));
+}
+
+template<uint8_t EmptyValue, typename Position>
+typename RecordFormat<EmptyValue, Position>::position_t RecordFormat<EmptyValue, Position>::padding(position_t size, position_t alignment) {
+    return (alignment - size % alignment) % alignment;
+}
+
+template<uint8_t EmptyValue, typename Position>
+typename RecordFormat<EmptyValue, Position>::position_t RecordFormat<EmptyValue, Position>::first(uint8_t version, position_t alignment) {
+    return version ? 1 /* bank header */ + padding(1 /* bank header */ + overhead, alignment) : 0;
+}
+
+template<uint8_t EmptyValue, typename Position>
+typename RecordFormat<EmptyValue, Position>::position_t RecordFormat<EmptyValue, Position>::size(position_t length, position_t alignment) {
+    return overhead + length /* payload */ + padding(overhead + length, alignment);
+}
+
+template<uint8_t EmptyValue, typename Position>
+typename RecordFormat<EmptyValue, Position>::position_t RecordFormat<EmptyValue, Position>::payload(position_t position) {
+    return position + 1 /* header */ + sizeof(position_t) /* length */;
+}
+
+template<uint8_t EmptyValue, typename Position>
+bool RecordFormat<EmptyValue, Position>::fits(position_t remaining, position_t length, position_t alignment) {
+    if (remaining < overhead + 1 /* next header */ || length > remaining - (overhead + 1 /* next header */))
+        return false;
+
+    // Here overhead + length can't overflow, but rounding it up could
+    return padding(overhead + length, alignment) <= remaining - (overhead + 1 /* next header */) - length;
+}
+
+template<uint8_t EmptyValue, typename Position>
+template<typename Bank>
+typename RecordFormat<EmptyValue, Position>::Header RecordFormat<EmptyValue, Position>::header(const Bank &bank, position_t position) {
+    Header header;
+    bank.read_chunk(position, &header, 1);
+    return header;
+}
+
+template<uint8_t EmptyValue, typename Position>
+template<typename Bank>
+uint8_t RecordFormat<EmptyValue, Position>::bank_version(const Bank &bank) {
+    uint8_t value = (uint8_t) header(bank, 0);
+
+    if (value == (uint8_t) Header::EMPTY || value == (uint8_t) Header::RECORD || value == (uint8_t) Header::SWITCH)
+        return 0;
+
+    value -= (uint8_t) Header::SWITCH;
+    if ((position_t) 1 << (value >> 4) > max_alignment)
+        return (uint8_t) -1;
+    return (uint8_t) (value & 0x0f);
+}
+
+template<uint8_t EmptyValue, typename Position>
+template<typename Bank>
+typename RecordFormat<EmptyValue, Position>::position_t RecordFormat<EmptyValue, Position>::bank_alignment(const Bank &bank) {
+    if (!bank_version(bank))
+        return 1;
+    return (position_t) 1 << ((uint8_t) ((uint8_t) header(bank, 0) - (uint8_t) Header::SWITCH) >> 4);
+}
+
+template<uint8_t EmptyValue, typename Position>
+template<typename Bank>
+typename RecordFormat<EmptyValue, Position>::position_t RecordFormat<EmptyValue, Position>::length(const Bank &bank, position_t position) {
+    position_t length;
+    bank.read_chunk(position + 1 /* header */, &length, sizeof(position_t));
+    return length;
+}
+
+template<uint8_t EmptyValue, typename Position>
+template<typename Bank>
+bool RecordFormat<EmptyValue, Position>::torn(const Bank &bank, position_t position) {
+    uint8_t length[sizeof(position_t)];
+    position_t size = std::min<position_t>(sizeof(position_t), bank.length() - position - 1 /* header */);
+
+    bank.read_chunk(position + 1 /* header */, length, size);
+    return std::any_of(length, length + size, [](uint8_t value) { return value != EmptyValue; });
+}
+
+template<uint8_t EmptyValue, typename Position>
+template<typename Bank>
+bool RecordFormat<EmptyValue, Position>::torn_header(const Bank &bank, position_t position, position_t alignment) {
+    position_t remaining = bank.length() - position;
+
+    // Programming only moves bits away from their erased value, towards the record header ones
+    if (((uint8_t) header(bank, position) ^ EmptyValue) & ~((uint8_t) Header::RECORD ^ EmptyValue))
+        return false;
+
+    if (remaining < 1 /* header */ + sizeof(position_t) /* length */ + 1 /* next header */ ||
+        !fits(remaining, length(bank, position), alignment))
+        return false;
+
+    position_t next = position + size(length(bank, position), alignment);
+    return next >= bank.length() || (header(bank, next) == Header::EMPTY && !torn(bank, next));
+}
+
+template<uint8_t EmptyValue, typename Position>
+template<typename Bank>
+bool RecordFormat<EmptyValue, Position>::torn_bank_header(const Bank &bank) {
+    uint8_t value = (uint8_t) header(bank, 0) ^ EmptyValue;
+    bool partial = false;
+
+    // Programming only moves bits away from their erased value, towards the bank header ones for some alignment
+    for (position_t alignment = 1; alignment <= max_alignment; alignment <<= 1)
+        partial = partial || !(value & ~((uint8_t) bank_header(version, alignment) ^ EmptyValue));
+    if (!partial)
+        return false;
+
+    position_t end = std::min<position_t>(bank.length(), first(version, max_alignment) + overhead);
+    for (position_t position = 1; position < end;) {
+        uint8_t chunk[32];
+        position_t size = std::min<position_t>(sizeof(chunk), end - position);
+
+        bank.read_chunk(position, chunk, size);
+        if (std::any_of(chunk, chunk + size, [](uint8_t value) { return value != EmptyValue; }))
+            return false;
+        position += size;
+    }
+    return true;
+}
+
+template<uint8_t EmptyValue, typename Position>
+template<typename Bank>
+typename RecordFormat<EmptyValue, Position>::Record RecordFormat<EmptyValue, Position>::probe(const Bank &bank, position_t position, position_t alignment) {
+    Record record = {Status::VALID, position, 0};
+    position_t remaining = bank.length() - position;
+
+    switch (header(bank, position)) {
+        case Header::EMPTY:
+            record.status = torn(bank, position) ? Status::TORN : Status::END;
+            break;
+
+        case Header::RECORD:
+            if (remaining < 1 /* header */ + sizeof(position_t) /* length */ + 1 /* next header */) {
+                record.status = Status::OPEN;
+                break;
+            }
+
+            record.length = length(bank, position);
+            if (!fits(remaining, record.length, alignment))
+                record.status = Status::BAD_LENGTH;
+            break;
+
+        default:
+            record.status = torn_header(bank, position, alignment) ? Status::TORN : Status::BAD_HEADER;
+            break;
+    }
+
+    return record;
+}
+
+template<uint8_t EmptyValue, typename Position>
+template<typename Bank, typename Tracer>
+typename RecordFormat<EmptyValue, Position>::State
+RecordFormat<EmptyValue, Position>::fast_forward(const Bank &bank, uint8_t id, uint8_t version, position_t alignment,
+                                                 Cursor &cursor, Tracer &tracer) {
+    cursor.bank = id;
+    cursor.version = version;
+    cursor.alignment = alignment;
+
+    for (position_t position = first(version, alignment);;) {
+        Record record = probe(bank, position, alignment);
+
+        switch (record.status) {
+            case Status::VALID:
+                tracer.record(id, position, record.length);
+                cursor.read_position = position;
+                position = cursor.write_position = position + size(record.length, alignment);
+                break;
+
+            case Status::END:
+                return State::VALID;
+
+            case Status::TORN:
+                // Give up the rest of the bank, so that the next write switches bank instead of programming over dirty flash
+                tracer.recovery(Recovery::TORN_RECORD, id, position);
+                cursor.write_position = bank.length();
+                return State::VALID;
+
+            case Status::OPEN:
+                tracer.recovery(Recovery::OPEN_RECORD, id, position);
+                return State::INVALID;
+
+            case Status::BAD_LENGTH:
+                tracer.recovery(Recovery::RECORD_LENGTH, id, position);
+                return State::INVALID;
+
+            case Status::BAD_HEADER:
+                tracer.recovery(Recovery::RECORD_HEADER, id, position);
+                return State::INVALID;
+        }
+    }
+}
+
+template<uint8_t EmptyValue, typename Position>
+template<typename Bank0, typename Bank1, typename Tracer>
+typename RecordFormat<EmptyValue, Position>::State
+RecordFormat<EmptyValue, Position>::locate(const Bank0 &bank0, const Bank1 &bank1, Cursor &cursor, Tracer &tracer) {
+    uint8_t version0 = bank_version(bank0), version1 = bank_version(bank1);
+
+    // A torn bank header leaves its bank without records, the other one keeps the configuration
+    bool torn0 = version0 > version && torn_bank_header(bank0), torn1 = version1 > version && torn_bank_header(bank1);
+
+    cursor.bank = cursor.version = 0;
+    cursor.alignment = 1;
+    cursor.read_position = cursor.write_position = 0;
+
+    if ((version0 > version && !torn0) || (version1 > version && !torn1) || (torn0 && torn1)) {
+        tracer.recovery(Recovery::BANK_HEADER, version0 > version && !torn0 ? 0 : 1, 0);
+        return State::INVALID;
+    }
+
+    if (torn0 || torn1) {
+        tracer.recovery(Recovery::TORN_RECORD, torn0 ? 0 : 1, 0);
+        version0 = torn0 ? 0 : version0;
+        version1 = torn1 ? 0 : version1;
+    }
+
+    position_t alignment0 = torn0 ? 1 : bank_alignment(bank0), alignment1 = torn1 ? 1 : bank_alignment(bank1);
+    position_t first0 = first(version0, alignment0), first1 = first(version1, alignment1);
+
+    // A corrupted bank header can claim an alignment placing the first record past the end of a short bank
+    if (first0 >= bank0.length() || first1 >= bank1.length()) {
+        tracer.recovery(Recovery::BANK_HEADER, first0 >= bank0.length() ? 0 : 1, 0);
+        return State::INVALID;
+    }
+
+    cursor.version = version0;
+    cursor.alignment = alignment0;
+    cursor.read_position = cursor.write_position = first0;
+
+    // From here on, check the first record of each bank
+    Header header0 = first_header(bank0), header1 = first_header(bank1);
+
+    if (header0 == Header::EMPTY && header1 == Header::EMPTY) {
+        // A torn first record (or bank header) would be programmed over by the next write
+        if (torn0)
+            return State::INVALID;
+        if (torn(bank0, first0)) {
+            tracer.recovery(Recovery::TORN_RECORD, 0, first0);
+            return State::INVALID;
+        }
+        return State::EMPTY;
+    } else if (header1 == Header::RECORD && (header0 == Header::EMPTY || header0 == Header::RECORD)) {
+        return fast_forward(bank1, 1, version1, alignment1, cursor, tracer);
+    } else if (header0 == Header::RECORD && header1 == Header::EMPTY) {
+        return fast_forward(bank0, 0, version0, alignment0, cursor, tracer);
+    } else {
+        bool bank1 = header0 == Header::EMPTY || header0 == Header::RECORD;
+        tracer.recovery(Recovery::BANK_HEADER, bank1 ? 1 : 0, 0);
+        return State::INVALID;
+    }
+}
+
+template<uint8_t EmptyValue, typename Position>
+template<typename Bank>
+typename RecordFormat<EmptyValue, Position>::Header RecordFormat<EmptyValue, Position>::first_header(const Bank &bank) {
+    uint8_t version = bank_version(bank);
+    if (version > RecordFormat::version)
+        return torn_bank_header(bank) ? Header::EMPTY : Header::SWITCH;
+
+    // A first record past the end of the bank is as corrupted as a newer version
+    position_t alignment = bank_alignment(bank), position = first(version, alignment);
+    if (position >= bank.length())
+        return Header::SWITCH;
+
+    // A first record torn by a failed commit holds no configuration, as if its header was empty
+    Header header = RecordFormat::header(bank, position);
+    if (header != Header::EMPTY && header != Header::RECORD && torn_header(bank, position, alignment))
+        return Header::EMPTY;
+    return header;
+}
+
+template<uint8_t EmptyValue, typename Position>
+template<typename Bank>
+bool RecordFormat<EmptyValue, Position>::matches_tail(const Bank &bank, const Cursor &cursor) {
+    if (cursor.version > version || bank_version(bank) != cursor.version || bank_alignment(bank) != cursor.alignment ||
+        cursor.read_position < first(cursor.version, cursor.alignment) || cursor.read_position >= bank.length() ||
+        header(bank, first(cursor.version, cursor.alignment)) != Header::RECORD)
+        return false;
+
+    Record record = probe(bank, cursor.read_position, cursor.alignment);
+    if (record.status != Status::VALID)
+        return false;
+
+    position_t tail = cursor.read_position + size(record.length, cursor.alignment);
+    if (cursor.write_position == bank.length() && tail < bank.length())
+        return probe(bank, tail, cursor.alignment).status == Status::TORN; // Bank given up after a torn record
+    return cursor.write_position == tail && probe(bank, tail, cursor.alignment).status == Status::END;
+}
+
+template<uint8_t EmptyValue, typename Position>
+template<typename Bank0, typename Bank1>
+bool RecordFormat<EmptyValue, Position>::matches(const Bank0 &bank0, const Bank1 &bank1, const Cursor &cursor) {
+    // Mirror locate(): bank1 holds the newest record whenever it has any, bank0 only when bank1 is empty
+    if (cursor.bank == 1) {
+        Header header0 = first_header(bank0);
+        return (header0 == Header::EMPTY || header0 == Header::RECORD) && matches_tail(bank1, cursor);
+    } else if (cursor.bank == 0) {
+        return first_header(bank1) == Header::EMPTY && matches_tail(bank0, cursor);
+    }
+    return false;
+}
+
+template<uint8_t EmptyValue, typename Position>
+template<typename Bank0, typename Bank1>
+uint32_t RecordFormat<EmptyValue, Position>::digest(const Bank0 &bank0, const Bank1 &bank1, const Cursor &cursor) {
+    return cursor.bank ? digest(bank1, cursor) : digest(bank0, cursor);
+}
+
+template<uint8_t EmptyValue, typename Position>
+template<typename Bank>
+uint32_t RecordFormat<EmptyValue, Position>::digest(const Bank &bank, const Cursor &cursor) {
+    uint32_t hash = 2166136261u; // FNV-1a
+
+    hash = digest(bank, first(cursor.version, cursor.alignment), overhead, hash);
+    return digest(bank, cursor.read_position, overhead + length(bank, cursor.read_position), hash);
+}
+
+template<uint8_t EmptyValue, typename Position>
+template<typename Bank>
+uint32_t RecordFormat<EmptyValue, Position>::digest(const Bank &bank, position_t position, position_t length, uint32_t hash) {
+    uint8_t chunk[32];
+
+    for (position_t offset = 0; offset < length;) {
+        position_t size = std::min<position_t>(sizeof(chunk), length - offset);
+
+        bank.read_chunk(position + offset, chunk, size);
+        for (position_t i = 0; i < size; i++)
+            hash = (hash ^ chunk[i]) * 16777619u;
+        offset += size;
+    }
+    return hash;
+}
+
+}
+
+#endif //TXFLASH_FORMAT_HH
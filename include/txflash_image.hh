@@ -0,0 +1,53 @@
+#ifndef TXFLASH_IMAGE_HH
+#define TXFLASH_IMAGE_HH
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "txflash.hh"
+#include "txflash_format.hh"
+#include "txflash_nor.hh"
+
+namespace txflash {
+
+/**
+ * Build the bank images of a flash holding the given payload as its only record, to be programmed along with the
+ * firmware image (eg. for factory provisioning). On first boot TxFlash will parse the payload as the current
+ * configuration, without writing the default one.
+ *
+ * Images are produced by running TxFlash itself over memory banks, so they are byte-exact with what the device would
+ * write. Bank1 is left erased, so it can be omitted when programming an already erased device.
+ *
+ * \tparam EmptyValue Device flash empty value
+ * \tparam Position Device position type
+ * \tparam Alignment Device TxFlash payload alignment
+ * \param bank0 Destination bank0 image, of at least length bytes
+ * \param bank1 Destination bank1 image, of at least length bytes
+ * \param length Bank length
+ * \param payload Payload to store
+ * \param payload_length Payload length
+ * \return True on success, false when the payload doesn't fit the banks
+ *
+ * @author Andrea Leofreddi
+ */
+template<uint8_t EmptyValue, typename Position, size_t Alignment = 1>
+bool build_image(uint8_t *bank0, uint8_t *bank1, size_t length, const void *payload, Position payload_length) {
+    using Bank = NorFlashBank<EmptyValue, Position>;
+    using Format = RecordFormat<EmptyValue, Position>;
+
+    if (length - 1 > (Position) -1 || length < Format::first(Format::version, Alignment) ||
+        !Format::fits(length - Format::first(Format::version, Alignment), payload_length, Alignment))
+        return false;
+
+    memset(bank0, EmptyValue, length);
+    memset(bank1, EmptyValue, length);
+
+    // Finding both banks empty, TxFlash stores the payload as the first record of bank0
+    TxFlash<Bank, Bank, NullTracer, Alignment> flash(Bank(bank0, length), Bank(bank1, length), payload, payload_length);
+    return true;
+}
+
+}
+
+#endif //TXFLASH_IMAGE_HH
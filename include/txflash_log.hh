@@ -0,0 +1,312 @@
+#ifndef TXFLASH_LOG_HH
+#define TXFLASH_LOG_HH
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <utility>
+
+#include "txflash_bank.hh"
+
+namespace txflash {
+
+/**
+ * Append-only ring log over two flash banks, keeping event records (eg. faults or counter snapshots) rather than the
+ * latest configuration only.
+ *
+ * Each bank is split into fixed size slots, made of a header byte, a sequence number, the payload length and the
+ * payload. Records are committed by programming the header last, so committed slots always form a prefix of the bank
+ * and the head is located by a binary search on boot. A slot torn by a power loss is marked as skipped on boot instead of
+ * being programmed again. When the current bank is full, the other one (holding the oldest records) is erased and
+ * appending continues there.
+ *
+ * \tparam Bank0 1st bank type
+ * \tparam Bank1 2nd bank type
+ * \tparam SlotSize Slot size in bytes, including the record overhead (see capacity)
+ *
+ * @author Andrea Leofreddi
+ */
+template<typename Bank0, typename Bank1, size_t SlotSize>
+class TxLog {
+private:
+    static_assert(Bank0::empty_value == Bank1::empty_value, "flash banks with different empty value");
+
+    static const uint8_t empty_value = Bank0::empty_value;
+
+    enum class Header : uint8_t {
+        EMPTY = empty_value,
+        RECORD = (uint8_t) ((uint16_t) empty_value + 1),
+        SKIP = (uint8_t) ((uint16_t) empty_value + 2)
+    };
+
+public:
+    using position_t = typename std::common_type<typename Bank0::position_t, typename Bank1::position_t>::type;
+
+    /**
+     * Maximum payload length of a record.
+     */
+    static const size_t capacity = SlotSize - 1 /* header */ - sizeof(uint32_t) /* sequence */ - sizeof(position_t) /* length */;
+
+    static_assert(SlotSize > 1 /* header */ + sizeof(uint32_t) /* sequence */ + sizeof(position_t) /* length */,
+                  "slot size too small");
+
+    /**
+     * Initialize the log using the given flash banks, locating the head.
+     *
+     * The constructed instance will take ownership of bank0 and bank1 (which will be moved into private fields).
+     *
+     * \param bank0 1st bank
+     * \param bank1 2nd bank
+     */
+    TxLog(Bank0 &&bank0, Bank1 &&bank1);
+
+    /**
+     * Append a record. Unless the current bank is full (so the oldest bank gets erased), this only programs the slot
+     * body and then its header.
+     *
+     * \param payload Record payload
+     * \param length Record length, up to capacity
+     * \return True if the operations succeed, else return false (eg. when the payload exceeds the slot capacity, or when
+     *         the bank reports a program failure, in which case the slot is skipped)
+     */
+    bool append(const void *payload, position_t length);
+
+    /**
+     * Visit the records from the oldest to the newest.
+     *
+     * \param visitor Callable as visitor(uint32_t sequence, const void *payload, position_t length)
+     */
+    template<typename Visitor>
+    void for_each(Visitor &&visitor) const;
+
+    /**
+     * Retrieve the sequence number the next record will be given.
+     *
+     * \return Next sequence number
+     */
+    uint32_t sequence() const;
+
+private:
+    enum class Bank : uint8_t {
+        BANK0 = 0,
+        BANK1 = 1
+    };
+
+    Bank0 m_bank0;
+    Bank1 m_bank1;
+
+    Bank m_bank;
+    position_t m_slot;
+    position_t m_count[2];
+    uint32_t m_sequence;
+
+    void initialize();
+
+    position_t slots(Bank bank) const;
+
+    Header header(Bank bank, position_t slot) const;
+
+    uint32_t sequence(Bank bank, position_t slot) const;
+
+    position_t count(Bank bank) const;
+
+    bool last(Bank bank, uint32_t &sequence) const;
+
+    bool blank(Bank bank, position_t slot) const;
+
+    void read_chunk(Bank bank, position_t position, void *destination, position_t length) const;
+
+    bool write_chunk(Bank bank, position_t position, const void *data, position_t length);
+
+    void erase(Bank bank);
+};
+
+template<typename Bank0, typename Bank1, size_t SlotSize>
+const size_t TxLog<Bank0, Bank1, SlotSize>::capacity;
+
+template<typename Bank0, typename Bank1, size_t SlotSize>
+TxLog<Bank0, Bank1, SlotSize>::TxLog(Bank0 &&bank0, Bank1 &&bank1)
+        : m_bank0(std::move(bank0)), m_bank1(std::move(bank1)) {
+    initialize();
+}
+
+template<typename Bank0, typename Bank1, size_t SlotSize>
+void TxLog<Bank0, Bank1, SlotSize>::initialize() {
+    uint32_t last0, last1;
+
+    m_count[0] = count(Bank::BANK0);
+    m_count[1] = count(Bank::BANK1);
+
+    bool records0 = last(Bank::BANK0, last0), records1 = last(Bank::BANK1, last1);
+
+    if (!records0 && !records1) {
+        // Nothing to keep: look full, so that the first append erases bank0 (whatever partial erase left behind)
+        m_bank = Bank::BANK1;
+        m_slot = slots(Bank::BANK1);
+        m_count[0] = m_count[1] = 0;
+        m_sequence = 0;
+        return;
+    }
+
+    // The newest bank holds the newest record (sequence numbers compared modulo 2^32)
+    if (records0 && (!records1 || (int32_t) (last0 - last1) > 0)) {
+        m_bank = Bank::BANK0;
+        m_sequence = last0 + 1;
+    } else {
+        m_bank = Bank::BANK1;
+        m_sequence = last1 + 1;
+    }
+    m_slot = m_count[(uint8_t) m_bank];
+
+    // A slot torn by a power loss can't be programmed again: skip it
+    if (m_slot < slots(m_bank) && !blank(m_bank, m_slot)) {
+        Header skip = Header::SKIP;
+        write_chunk(m_bank, m_slot * SlotSize, &skip, 1);
+        m_count[(uint8_t) m_bank] = ++m_slot;
+    }
+}
+
+template<typename Bank0, typename Bank1, size_t SlotSize>
+typename TxLog<Bank0, Bank1, SlotSize>::position_t TxLog<Bank0, Bank1, SlotSize>::slots(Bank bank) const {
+    return (bank == Bank::BANK0 ? m_bank0.length() : m_bank1.length()) / SlotSize;
+}
+
+template<typename Bank0, typename Bank1, size_t SlotSize>
+typename TxLog<Bank0, Bank1, SlotSize>::Header TxLog<Bank0, Bank1, SlotSize>::header(Bank bank, position_t slot) const {
+    Header header;
+    read_chunk(bank, slot * SlotSize, &header, 1);
+    return header;
+}
+
+template<typename Bank0, typename Bank1, size_t SlotSize>
+uint32_t TxLog<Bank0, Bank1, SlotSize>::sequence(Bank bank, position_t slot) const {
+    uint32_t sequence;
+    read_chunk(bank, slot * SlotSize + 1 /* header */, &sequence, sizeof(uint32_t));
+    return sequence;
+}
+
+template<typename Bank0, typename Bank1, size_t SlotSize>
+typename TxLog<Bank0, Bank1, SlotSize>::position_t TxLog<Bank0, Bank1, SlotSize>::count(Bank bank) const {
+    // Committed (or skipped) slots form a prefix, unless an erase got interrupted: then the bank is ignored
+    if (!slots(bank) || header(bank, 0) == Header::EMPTY)
+        return 0;
+
+    position_t low = 1, high = slots(bank);
+    while (low < high) {
+        position_t middle = low + (high - low) / 2;
+        if (header(bank, middle) == Header::EMPTY)
+            high = middle;
+        else
+            low = middle + 1;
+    }
+    return low;
+}
+
+template<typename Bank0, typename Bank1, size_t SlotSize>
+bool TxLog<Bank0, Bank1, SlotSize>::last(Bank bank, uint32_t &sequence) const {
+    for (position_t slot = m_count[(uint8_t) bank]; slot > 0; slot--) {
+        if (header(bank, slot - 1) == Header::RECORD) {
+            sequence = this->sequence(bank, slot - 1);
+            return true;
+        }
+    }
+    return false;
+}
+
+template<typename Bank0, typename Bank1, size_t SlotSize>
+bool TxLog<Bank0, Bank1, SlotSize>::blank(Bank bank, position_t slot) const {
+    uint8_t data[SlotSize];
+
+    read_chunk(bank, slot * SlotSize, data, SlotSize);
+    return std::all_of(data, data + SlotSize, [](uint8_t value) { return value == empty_value; });
+}
+
+template<typename Bank0, typename Bank1, size_t SlotSize>
+bool TxLog<Bank0, Bank1, SlotSize>::append(const void *payload, position_t length) {
+    if (length > capacity || !slots(Bank::BANK0) || !slots(Bank::BANK1))
+        return false;
+
+    if (m_slot == slots(m_bank)) {
+        // Erase the oldest bank and continue there
+        m_bank = m_bank == Bank::BANK0 ? Bank::BANK1 : Bank::BANK0;
+        erase(m_bank);
+        m_slot = m_count[(uint8_t) m_bank] = 0;
+    }
+
+    position_t position = m_slot * SlotSize;
+    uint8_t body[SlotSize - 1 /* header */];
+
+    // Write sequence, length and payload at once
+    memcpy(body, &m_sequence, sizeof(uint32_t));
+    memcpy(body + sizeof(uint32_t), &length, sizeof(position_t));
+    memcpy(body + sizeof(uint32_t) + sizeof(position_t), payload, length);
+    bool result = write_chunk(m_bank, position + 1 /* header */, body, sizeof(uint32_t) + sizeof(position_t) + length);
+
+    // Write header
+    Header header = Header::RECORD;
+    result = result && write_chunk(m_bank, position, &header, 1);
+
+    // Skip a slot torn by a program failure, as done on boot for power losses, so that committed slots stay a prefix
+    if (!result) {
+        Header skip = Header::SKIP;
+        write_chunk(m_bank, position, &skip, 1);
+    }
+
+    m_count[(uint8_t) m_bank] = ++m_slot;
+    m_sequence++;
+
+    return result;
+}
+
+template<typename Bank0, typename Bank1, size_t SlotSize>
+template<typename Visitor>
+void TxLog<Bank0, Bank1, SlotSize>::for_each(Visitor &&visitor) const {
+    const Bank order[] = {m_bank == Bank::BANK0 ? Bank::BANK1 : Bank::BANK0, m_bank};
+    uint8_t payload[capacity];
+
+    for (Bank bank : order) {
+        for (position_t slot = 0; slot < m_count[(uint8_t) bank]; slot++) {
+            if (header(bank, slot) != Header::RECORD)
+                continue;
+
+            position_t position = slot * SlotSize, length;
+            read_chunk(bank, position + 1 /* header */ + sizeof(uint32_t) /* sequence */, &length, sizeof(position_t));
+            length = std::min(length, (position_t) capacity);
+            read_chunk(bank, position + 1 /* header */ + sizeof(uint32_t) /* sequence */ + sizeof(position_t) /* length */,
+                       payload, length);
+
+            visitor(sequence(bank, slot), (const void *) payload, length);
+        }
+    }
+}
+
+template<typename Bank0, typename Bank1, size_t SlotSize>
+uint32_t TxLog<Bank0, Bank1, SlotSize>::sequence() const {
+    return m_sequence;
+}
+
+template<typename Bank0, typename Bank1, size_t SlotSize>
+void TxLog<Bank0, Bank1, SlotSize>::read_chunk(Bank bank, position_t position, void *destination, position_t length) const {
+    return bank == Bank::BANK0 ? m_bank0.read_chunk(position, destination, length)
+                               : m_bank1.read_chunk(position, destination, length);
+}
+
+template<typename Bank0, typename Bank1, size_t SlotSize>
+bool TxLog<Bank0, Bank1, SlotSize>::write_chunk(Bank bank, position_t position, const void *data, position_t length) {
+    return bank == Bank::BANK0 ? program_chunk(m_bank0, position, data, length)
+                               : program_chunk(m_bank1, position, data, length);
+}
+
+template<typename Bank0, typename Bank1, size_t SlotSize>
+void TxLog<Bank0, Bank1, SlotSize>::erase(Bank bank) {
+    if (bank == Bank::BANK0)
+        m_bank0.erase();
+    else
+        m_bank1.erase();
+}
+
+}
+
+#endif //TXFLASH_LOG_HH
@@ -0,0 +1,112 @@
+#ifndef TXFLASH_NOR_HH
+#define TXFLASH_NOR_HH
+
+#include <cassert>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+namespace txflash {
+
+/**
+ * Operation counters of a simulated NOR flash bank.
+ */
+struct NorFlashCounters {
+    uint32_t erases;
+    uint32_t programs;
+    uint32_t programmed_bytes;
+    uint32_t reads;
+    uint32_t read_bytes;
+};
+
+/**
+ * A memory buffer backed flash bank simulating NOR semantics: programming can only move bits away from their erased
+ * state, and only an erase restores them. Operations can be counted into an externally owned NorFlashCounters, which
+ * survives the bank being moved into a TxFlash. This implementation is useful for testing and benchmarking.
+ *
+ * \tparam EmptyValue Value of erased bytes
+ * \tparam Position Position type, bounding the bank length
+ *
+ * @author Andrea Leofreddi
+ */
+template<uint8_t EmptyValue = 0xff, typename Position = uint32_t>
+class NorFlashBank {
+public:
+    static const uint8_t empty_value = EmptyValue;
+    using position_t = Position;
+
+    NorFlashBank(uint8_t *data, size_t length, NorFlashCounters *counters = nullptr);
+
+    NorFlashBank() = delete;
+
+    position_t length() const;
+
+    const uint8_t *data() const;
+
+    void erase();
+
+    void read_chunk(position_t position, void *destination, position_t length) const;
+
+    void write_chunk(position_t position, const void *payload, position_t length);
+
+private:
+    // Mask turning EmptyValue into 0xff, so that programming becomes a bitwise and
+    static const uint8_t mask = EmptyValue ^ 0xff;
+
+    uint8_t *m_flash;
+    position_t m_length;
+    NorFlashCounters *m_counters;
+};
+
+template<uint8_t EmptyValue, typename Position>
+NorFlashBank<EmptyValue, Position>::NorFlashBank(uint8_t *data, size_t length, NorFlashCounters *counters)
+        : m_flash(data), m_length(length), m_counters(counters) {
+}
+
+template<uint8_t EmptyValue, typename Position>
+typename NorFlashBank<EmptyValue, Position>::position_t NorFlashBank<EmptyValue, Position>::length() const {
+    return m_length;
+}
+
+template<uint8_t EmptyValue, typename Position>
+const uint8_t *NorFlashBank<EmptyValue, Position>::data() const {
+    return m_flash;
+}
+
+template<uint8_t EmptyValue, typename Position>
+void NorFlashBank<EmptyValue, Position>::erase() {
+    memset(m_flash, EmptyValue, m_length);
+
+    if (m_counters)
+        m_counters->erases++;
+}
+
+template<uint8_t EmptyValue, typename Position>
+void NorFlashBank<EmptyValue, Position>::read_chunk(position_t position, void *destination, position_t length) const {
+    assert(position + length <= m_length);
+    memcpy(destination, m_flash + position, length);
+
+    if (m_counters) {
+        m_counters->reads++;
+        m_counters->read_bytes += length;
+    }
+}
+
+template<uint8_t EmptyValue, typename Position>
+void NorFlashBank<EmptyValue, Position>::write_chunk(position_t position, const void *payload, position_t length) {
+    assert(position + length <= m_length);
+    uint8_t *current = m_flash + position;
+    const uint8_t *read = (const uint8_t *) payload;
+
+    for (position_t i = 0; i < length; i++)
+        current[i] = ((current[i] ^ mask) & (read[i] ^ mask)) ^ mask;
+
+    if (m_counters) {
+        m_counters->programs++;
+        m_counters->programmed_bytes += length;
+    }
+}
+
+}
+
+#endif //TXFLASH_NOR_HH
@@ -0,0 +1,114 @@
+#ifndef TXFLASH_OBSERVER_HH
+#define TXFLASH_OBSERVER_HH
+
+#include <cstddef>
+
+namespace txflash {
+
+/**
+ * Fixed capacity list of observers, each made of a callback function and a context pointer, so that neither the list
+ * nor the observers need allocations.
+ *
+ * \tparam Event Event type, passed to callbacks by reference
+ * \tparam Capacity Maximum number of observers
+ *
+ * @author Andrea Leofreddi
+ */
+template<typename Event, size_t Capacity>
+class ObserverList {
+public:
+    using callback_t = void (*)(void *context, const Event &event);
+
+    /**
+     * Add an observer.
+     *
+     * \param callback Callback function
+     * \param context Context passed to the callback
+     * \return False when the list is full
+     */
+    bool add(callback_t callback, void *context);
+
+    /**
+     * Remove an observer, matching both the callback and the context.
+     *
+     * \return False when not found
+     */
+    bool remove(callback_t callback, void *context);
+
+    /**
+     * Tell whether there are no observers.
+     */
+    bool empty() const {
+        return !m_size;
+    }
+
+    /**
+     * Notify observers, in the order they have been added.
+     */
+    void notify(const Event &event) const;
+
+private:
+    struct Observer {
+        callback_t callback;
+        void *context;
+    };
+
+    Observer m_observers[Capacity];
+    size_t m_size = 0;
+};
+
+/**
+ * An empty observer list, compiling to nothing.
+ */
+template<typename Event>
+class ObserverList<Event, 0> {
+public:
+    using callback_t = void (*)(void *context, const Event &event);
+
+    bool add(callback_t /* callback */, void * /* context */) {
+        return false;
+    }
+
+    bool remove(callback_t /* callback */, void * /* context */) {
+        return false;
+    }
+
+    bool empty() const {
+        return true;
+    }
+
+    void notify(const Event & /* event */) const {
+    }
+};
+
+template<typename Event, size_t Capacity>
+bool ObserverList<Event, Capacity>::add(callback_t callback, void *context) {
+    if (m_size == Capacity)
+        return false;
+
+    m_observers[m_size++] = {callback, context};
+    return true;
+}
+
+template<typename Event, size_t Capacity>
+bool ObserverList<Event, Capacity>::remove(callback_t callback, void *context) {
+    for (size_t i = 0; i < m_size; i++) {
+        if (m_observers[i].callback == callback && m_observers[i].context == context) {
+            // Keep the notification order
+            for (m_size--; i < m_size; i++)
+                m_observers[i] = m_observers[i + 1];
+            return true;
+        }
+    }
+    return false;
+}
+
+template<typename Event, size_t Capacity>
+void ObserverList<Event, Capacity>::notify(const Event &event) const {
+    for (size_t i = 0; i < m_size; i++)
+        m_observers[i].callback(m_observers[i].context, event);
+}
+
+}
+
+#endif //TXFLASH_OBSERVER_HH
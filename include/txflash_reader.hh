@@ -0,0 +1,117 @@
+#ifndef TXFLASH_READER_HH
+#define TXFLASH_READER_HH
+
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+
+#include "txflash_format.hh"
+#include "txflash_tracer.hh"
+
+namespace txflash {
+
+/**
+ * Read-only access to the latest record stored by TxFlash, eg. for bootloaders. The record is located on construction
+ * through the shared record format code, without any write or erase path: banks only need to provide empty_value,
+ * position_t, length() and read_chunk(), and flash is never modified (even when empty or corrupted, which is reported
+ * by valid() instead).
+ *
+ * \tparam Bank0 1st bank type
+ * \tparam Bank1 2nd bank type
+ *
+ * @author Andrea Leofreddi
+ */
+template<typename Bank0, typename Bank1>
+class TxFlashReader {
+private:
+    static_assert(Bank0::empty_value == Bank1::empty_value, "flash banks with different empty value");
+
+    static const uint8_t empty_value = Bank0::empty_value;
+
+public:
+    using position_t = typename std::common_type<typename Bank0::position_t, typename Bank1::position_t>::type;
+
+    /**
+     * Initialize the reader, locating the latest record.
+     *
+     * The constructed instance will take ownership of bank0 and bank1 (which will be moved into private fields).
+     *
+     * \param bank0 1st bank
+     * \param bank1 2nd bank
+     */
+    TxFlashReader(Bank0 &&bank0, Bank1 &&bank1);
+
+    /**
+     * Tell whether a valid record has been found.
+     *
+     * \return False when flash is empty or corrupted
+     */
+    bool valid() const;
+
+    /**
+     * Retrieve the record length.
+     *
+     * \return Record length, 0 when no valid record has been found
+     */
+    position_t length() const;
+
+    /**
+     * Copy up to length bytes of the record into the destination buffer.
+     *
+     * \param destination Destination buffer
+     * \param length Destination buffer length
+     * \return Copied bytes
+     */
+    position_t read(void *destination, position_t length) const;
+
+private:
+    using Format = RecordFormat<empty_value, position_t>;
+
+    Bank0 m_bank0;
+    Bank1 m_bank1;
+
+    bool m_valid;
+    typename Format::Cursor m_cursor;
+    position_t m_length;
+};
+
+template<typename Bank0, typename Bank1>
+TxFlashReader<Bank0, Bank1>::TxFlashReader(Bank0 &&bank0, Bank1 &&bank1)
+        : m_bank0(std::move(bank0)), m_bank1(std::move(bank1)), m_length(0) {
+    NullTracer tracer;
+
+    m_valid = Format::locate(m_bank0, m_bank1, m_cursor, tracer) == Format::State::VALID;
+    if (m_valid)
+        m_length = m_cursor.bank ? Format::length(m_bank1, m_cursor.read_position)
+                                 : Format::length(m_bank0, m_cursor.read_position);
+}
+
+template<typename Bank0, typename Bank1>
+bool TxFlashReader<Bank0, Bank1>::valid() const {
+    return m_valid;
+}
+
+template<typename Bank0, typename Bank1>
+typename TxFlashReader<Bank0, Bank1>::position_t TxFlashReader<Bank0, Bank1>::length() const {
+    return m_length;
+}
+
+template<typename Bank0, typename Bank1>
+typename TxFlashReader<Bank0, Bank1>::position_t TxFlashReader<Bank0, Bank1>::read(void *destination, position_t length) const {
+    position_t position = Format::payload(m_cursor.read_position);
+
+    if (length > m_length)
+        length = m_length;
+    if (!length)
+        return 0;
+
+    if (m_cursor.bank)
+        m_bank1.read_chunk(position, destination, length);
+    else
+        m_bank0.read_chunk(position, destination, length);
+    return length;
+}
+
+}
+
+#endif //TXFLASH_READER_HH
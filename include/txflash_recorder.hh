@@ -0,0 +1,345 @@
+#ifndef TXFLASH_RECORDER_HH
+#define TXFLASH_RECORDER_HH
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+
+#include "txflash_bank.hh"
+
+namespace txflash {
+
+/**
+ * Flash trace format version.
+ */
+const uint8_t trace_version = 1;
+
+/**
+ * Operations stored into a flash trace.
+ */
+enum class TraceOp : uint8_t {
+    OPEN = 0,  ///< Bank declaration: length, empty value and position size
+    ERASE = 1, ///< Bank erase
+    READ = 2,  ///< Chunk read: position and length
+    WRITE = 3  ///< Chunk write: position, length and data
+};
+
+/**
+ * A flash trace event.
+ */
+struct TraceEvent {
+    TraceOp op;
+    uint8_t bank;
+    uint64_t position;
+    uint64_t length;
+    uint8_t empty_value;     ///< OPEN only
+    uint8_t position_size;   ///< OPEN only
+    const uint8_t *data;     ///< WRITE only, points into the trace
+};
+
+/**
+ * Writes a compact binary flash trace into a sink, which is any type exposing a write(const void *, size_t) method.
+ *
+ * A trace starts with the "TXFT" magic followed by the trace_version byte, then a sequence of events. Each event is made
+ * of the operation and bank bytes, followed by LEB128 encoded position and length (OPEN events store the bank length,
+ * empty value and position size instead) and, for writes only, the written data.
+ *
+ * \tparam Sink Sink type
+ *
+ * @author Andrea Leofreddi
+ */
+template<typename Sink>
+class TraceWriter {
+public:
+    /**
+     * Initialize the trace writer, writing the trace header into the sink.
+     *
+     * \param sink Sink, which must outlive the writer
+     */
+    explicit TraceWriter(Sink &sink);
+
+    void open(uint8_t bank, uint64_t length, uint8_t empty_value, uint8_t position_size);
+
+    void erase(uint8_t bank);
+
+    void read(uint8_t bank, uint64_t position, uint64_t length);
+
+    void write(uint8_t bank, uint64_t position, const void *data, uint64_t length);
+
+private:
+    Sink &m_sink;
+
+    void put(TraceOp op, uint8_t bank);
+
+    void put(uint64_t value);
+};
+
+template<typename Sink>
+TraceWriter<Sink>::TraceWriter(Sink &sink) : m_sink(sink) {
+    const uint8_t header[] = {'T', 'X', 'F', 'T', trace_version};
+    m_sink.write(header, sizeof(header));
+}
+
+template<typename Sink>
+void TraceWriter<Sink>::put(TraceOp op, uint8_t bank) {
+    const uint8_t buffer[] = {(uint8_t) op, bank};
+    m_sink.write(buffer, sizeof(buffer));
+}
+
+template<typename Sink>
+void TraceWriter<Sink>::put(uint64_t value) {
+    uint8_t buffer[10];
+    size_t length = 0;
+
+    do {
+        buffer[length++] = (uint8_t) ((value & 0x7f) | (value > 0x7f ? 0x80 : 0));
+        value >>= 7;
+    } while (value);
+    m_sink.write(buffer, length);
+}
+
+template<typename Sink>
+void TraceWriter<Sink>::open(uint8_t bank, uint64_t length, uint8_t empty_value, uint8_t position_size) {
+    const uint8_t buffer[] = {empty_value, position_size};
+    put(TraceOp::OPEN, bank);
+    put(length);
+    m_sink.write(buffer, sizeof(buffer));
+}
+
+template<typename Sink>
+void TraceWriter<Sink>::erase(uint8_t bank) {
+    put(TraceOp::ERASE, bank);
+}
+
+template<typename Sink>
+void TraceWriter<Sink>::read(uint8_t bank, uint64_t position, uint64_t length) {
+    put(TraceOp::READ, bank);
+    put(position);
+    put(length);
+}
+
+template<typename Sink>
+void TraceWriter<Sink>::write(uint8_t bank, uint64_t position, const void *data, uint64_t length) {
+    put(TraceOp::WRITE, bank);
+    put(position);
+    put(length);
+    m_sink.write(data, length);
+}
+
+/**
+ * Bank wrapper recording every erase, read_chunk and write_chunk call into a trace before forwarding it to the
+ * wrapped bank. The bank is declared into the trace on construction.
+ *
+ * \tparam Bank Wrapped bank type
+ * \tparam Sink Trace sink type
+ *
+ * @author Andrea Leofreddi
+ */
+template<typename Bank, typename Sink>
+class RecordingFlashBank {
+public:
+    static const uint8_t empty_value = Bank::empty_value;
+    using position_t = typename Bank::position_t;
+
+    /**
+     * Initialize the recording bank.
+     *
+     * \param bank Wrapped bank, which will be moved into a private field
+     * \param writer Trace writer, which must outlive the bank
+     * \param id Bank identifier stored into the trace (eg. 0 and 1 for TxFlash's banks)
+     */
+    RecordingFlashBank(Bank &&bank, TraceWriter<Sink> &writer, uint8_t id);
+
+    position_t length() const;
+
+    void erase();
+
+    void read_chunk(position_t position, void *destination, position_t length) const;
+
+    bool write_chunk(position_t position, const void *payload, position_t length);
+
+private:
+    Bank m_bank;
+    TraceWriter<Sink> *m_writer;
+    uint8_t m_id;
+};
+
+template<typename Bank, typename Sink>
+RecordingFlashBank<Bank, Sink>::RecordingFlashBank(Bank &&bank, TraceWriter<Sink> &writer, uint8_t id)
+        : m_bank(std::move(bank)), m_writer(&writer), m_id(id) {
+    m_writer->open(m_id, m_bank.length(), empty_value, sizeof(position_t));
+}
+
+template<typename Bank, typename Sink>
+typename RecordingFlashBank<Bank, Sink>::position_t RecordingFlashBank<Bank, Sink>::length() const {
+    return m_bank.length();
+}
+
+template<typename Bank, typename Sink>
+void RecordingFlashBank<Bank, Sink>::erase() {
+    m_writer->erase(m_id);
+    m_bank.erase();
+}
+
+template<typename Bank, typename Sink>
+void RecordingFlashBank<Bank, Sink>::read_chunk(position_t position, void *destination, position_t length) const {
+    m_writer->read(m_id, position, length);
+    m_bank.read_chunk(position, destination, length);
+}
+
+template<typename Bank, typename Sink>
+bool RecordingFlashBank<Bank, Sink>::write_chunk(position_t position, const void *payload, position_t length) {
+    m_writer->write(m_id, position, payload, length);
+    return program_chunk(m_bank, position, payload, length);
+}
+
+/**
+ * Zero-copy reader of a binary flash trace held in memory.
+ *
+ * @author Andrea Leofreddi
+ */
+class TraceReader {
+public:
+    /**
+     * Initialize the reader, validating the trace header.
+     *
+     * \param data Trace data, which must outlive the reader
+     * \param length Trace length
+     */
+    TraceReader(const void *data, size_t length);
+
+    /**
+     * Read the next event.
+     *
+     * \param event Destination event
+     * \return True when an event has been read, false at the end of the trace or on malformed content (see valid())
+     */
+    bool next(TraceEvent &event);
+
+    /**
+     * Tell whether the trace has been well formed so far.
+     *
+     * \return False when the header or an event is malformed
+     */
+    bool valid() const;
+
+private:
+    const uint8_t *m_current, *m_end;
+    bool m_valid;
+
+    bool get(uint64_t &value);
+};
+
+inline TraceReader::TraceReader(const void *data, size_t length)
+        : m_current((const uint8_t *) data), m_end((const uint8_t *) data + length) {
+    m_valid = length >= 5 && !memcmp(m_current, "TXFT", 4) && m_current[4] == trace_version;
+    m_current += m_valid ? 5 : 0;
+}
+
+inline bool TraceReader::get(uint64_t &value) {
+    value = 0;
+    for (unsigned shift = 0; m_current < m_end && shift < 64; shift += 7) {
+        uint8_t byte = *m_current++;
+        value |= (uint64_t) (byte & 0x7f) << shift;
+        if (!(byte & 0x80))
+            return true;
+    }
+    return false;
+}
+
+inline bool TraceReader::next(TraceEvent &event) {
+    if (!m_valid || m_current == m_end)
+        return false;
+
+    if (m_end - m_current < 2 || m_current[0] > (uint8_t) TraceOp::WRITE)
+        return m_valid = false;
+
+    event = TraceEvent();
+    event.op = (TraceOp) *m_current++;
+    event.bank = *m_current++;
+
+    switch (event.op) {
+        case TraceOp::OPEN:
+            if (!get(event.length) || m_end - m_current < 2)
+                return m_valid = false;
+            event.empty_value = *m_current++;
+            event.position_size = *m_current++;
+            break;
+
+        case TraceOp::ERASE:
+            break;
+
+        case TraceOp::READ:
+        case TraceOp::WRITE:
+            if (!get(event.position) || !get(event.length))
+                return m_valid = false;
+            if (event.op == TraceOp::WRITE) {
+                if ((uint64_t) (m_end - m_current) < event.length)
+                    return m_valid = false;
+                event.data = m_current;
+                m_current += event.length;
+            }
+            break;
+    }
+
+    return true;
+}
+
+inline bool TraceReader::valid() const {
+    return m_valid;
+}
+
+/**
+ * Replay the bank operations of a trace against a pair of banks, which must be at least as long as the traced ones.
+ *
+ * \param reader Trace reader
+ * \param bank0 Bank replaying bank 0 operations
+ * \param bank1 Bank replaying bank 1 operations
+ * \return True when the whole trace has been replayed, false on malformed trace (including reads and writes outside
+ *         the banks, which are not replayed)
+ */
+template<typename Bank0, typename Bank1>
+bool replay_trace(TraceReader &reader, Bank0 &bank0, Bank1 &bank1) {
+    uint8_t buffer[64];
+
+    for (TraceEvent event; reader.next(event);) {
+        if (event.bank > 1)
+            continue;
+
+        // Reject operations outside the bank, without overflowing position + length
+        uint64_t length = event.bank ? (uint64_t) bank1.length() : (uint64_t) bank0.length();
+        if ((event.op == TraceOp::READ || event.op == TraceOp::WRITE) &&
+            (event.position > length || event.length > length - event.position))
+            return false;
+
+        switch (event.op) {
+            case TraceOp::ERASE:
+                event.bank ? bank1.erase() : bank0.erase();
+                break;
+
+            case TraceOp::READ:
+                for (uint64_t offset = 0; offset < event.length; offset += sizeof(buffer)) {
+                    auto length = std::min<uint64_t>(sizeof(buffer), event.length - offset);
+                    event.bank ? bank1.read_chunk(event.position + offset, buffer, length)
+                               : bank0.read_chunk(event.position + offset, buffer, length);
+                }
+                break;
+
+            case TraceOp::WRITE:
+                event.bank ? bank1.write_chunk(event.position, event.data, event.length)
+                           : bank0.write_chunk(event.position, event.data, event.length);
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    return reader.valid();
+}
+
+}
+
+#endif //TXFLASH_RECORDER_HH
@@ -33,9 +33,16 @@ public:
     Stm32f7FlashBank(Stm32f7FlashBank &&) = default;
 
     size_t length() const;
+    const uint8_t *data() const;
     void erase();
     void read_chunk(size_t position, void *destination, size_t length) const;
-    void write_chunk(size_t position, const void *payload, size_t length);
+
+    /**
+     * Program a chunk, stopping at the first program operation failed by the flash controller (eg. on a worn out cell).
+     *
+     * \return False on failure, in which case the chunk is partially programmed
+     */
+    bool write_chunk(size_t position, const void *payload, size_t length);
 };
 
 template<uint8_t Sector, uint32_t Address, uint32_t Length>
@@ -43,6 +50,11 @@ size_t Stm32f7FlashBank<Sector, Address, Length>::length() const {
     return Length;
 }
 
+template<uint8_t Sector, uint32_t Address, uint32_t Length>
+const uint8_t *Stm32f7FlashBank<Sector, Address, Length>::data() const {
+    return (const uint8_t *) Address;
+}
+
 template<uint8_t Sector, uint32_t Address, uint32_t Length>
 void Stm32f7FlashBank<Sector, Address, Length>::erase() {
     HAL_FLASH_Unlock();
@@ -56,24 +68,23 @@ void Stm32f7FlashBank<Sector, Address, Length>::read_chunk(size_t position, void
 }
 
 template<uint8_t Sector, uint32_t Address, uint32_t Length>
-void Stm32f7FlashBank<Sector, Address, Length>::write_chunk(size_t position, const void *source, size_t length) {
+bool Stm32f7FlashBank<Sector, Address, Length>::write_chunk(size_t position, const void *source, size_t length) {
     assert(position + length <= Length);
     char *current = (char *) Address + position, *end = current + length, *read = (char *) source;
+    bool result = true;
     HAL_FLASH_Unlock();
 
-    for(; (uint32_t) current % 4 && current < end; current++, read++)
-        if(HAL_FLASH_Program(TYPEPROGRAM_BYTE, (uint32_t) current, (uint8_t) *read) != HAL_OK)
-            Error_Handler();
+    for(; result && (uintptr_t) current % 4 && current < end; current++, read++)
+        result = HAL_FLASH_Program(TYPEPROGRAM_BYTE, (uintptr_t) current, (uint8_t) *read) == HAL_OK;
 
-    for(; current + 4 < end; current += 4, read += 4)
-        if(HAL_FLASH_Program(TYPEPROGRAM_WORD, (uint32_t) current, *((uint32_t *) read)) != HAL_OK)
-            Error_Handler();
+    for(; result && current + 4 <= end; current += 4, read += 4)
+        result = HAL_FLASH_Program(TYPEPROGRAM_WORD, (uintptr_t) current, *((uint32_t *) read)) == HAL_OK;
 
-    for(; current < end; current++, read++)
-        if(HAL_FLASH_Program(TYPEPROGRAM_BYTE, (uint32_t) current, (uint8_t) *read) != HAL_OK)
-            Error_Handler();
+    for(; result && current < end; current++, read++)
+        result = HAL_FLASH_Program(TYPEPROGRAM_BYTE, (uintptr_t) current, (uint8_t) *read) == HAL_OK;
 
     HAL_FLASH_Lock();
+    return result;
 }
 
 }
@@ -0,0 +1,264 @@
+#ifndef TXFLASH_TIMING_HH
+#define TXFLASH_TIMING_HH
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+#include "txflash_tracer.hh"
+
+namespace txflash {
+
+/**
+ * Operations timed by TimingTracer.
+ */
+enum class Operation : uint8_t {
+    PARSE = 0,  ///< Boot time flash parsing
+    WRITE = 1,  ///< Whole write, including an eventual bank switch
+    ERASE = 2,  ///< Single bank erase
+    SWITCH = 3  ///< Bank switch, including erases and the record write
+};
+
+/**
+ * Host clock backed by std::chrono::steady_clock, ticking nanoseconds.
+ *
+ * A clock is any type exposing a tick_t unsigned type and a static now() method. On Cortex-M the DWT cycle counter is a
+ * good candidate:
+ *
+ * \code
+ * struct DwtClock {
+ *     using tick_t = uint32_t;
+ *     static tick_t now() { return DWT->CYCCNT; }
+ * };
+ * \endcode
+ *
+ * @author Andrea Leofreddi
+ */
+struct SteadyClock {
+    using tick_t = uint64_t;
+
+    static tick_t now() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()
+        ).count();
+    }
+};
+
+/**
+ * Tracer measuring the duration of TxFlash operations, keeping minimum, maximum, total and a logarithmic histogram for
+ * each of them. Writes are also timed per payload size, so that slow writes can be told apart from large ones. Events
+ * are forwarded to the Next tracer, so timing can be stacked over any other tracer.
+ *
+ * Histogram bucket i counts the durations d such that 2^i <= d < 2^(i + 1) ticks (bucket 0 includes zero), the last
+ * bucket collects everything above. Size buckets split the payload lengths the same way.
+ *
+ * \tparam Clock Clock type (see SteadyClock)
+ * \tparam Buckets Number of histogram buckets
+ * \tparam Next Tracer to forward events to
+ * \tparam SizeBuckets Number of write size buckets
+ *
+ * @author Andrea Leofreddi
+ */
+template<typename Clock, size_t Buckets = 32, typename Next = NullTracer, size_t SizeBuckets = 8>
+class TimingTracer : public Next {
+public:
+    static_assert(Buckets > 0, "timing tracer needs at least one histogram bucket");
+    static_assert(SizeBuckets > 0, "timing tracer needs at least one size bucket");
+
+    using tick_t = typename Clock::tick_t;
+
+    /**
+     * Timing statistics for a single operation. Minimum and maximum are meaningful only when count is non-zero.
+     */
+    struct Stats {
+        uint32_t count;
+        tick_t min;
+        tick_t max;
+        uint64_t total;
+        uint32_t histogram[Buckets];
+    };
+
+    TimingTracer();
+
+    /**
+     * Retrieve the statistics of an operation.
+     *
+     * \param operation Operation
+     * \return Statistics
+     */
+    const Stats &stats(Operation operation) const;
+
+    /**
+     * Retrieve the statistics of writes whose payload length falls into a size bucket (see size_bucket()).
+     *
+     * \param bucket Size bucket, less than SizeBuckets
+     * \return Statistics
+     */
+    const Stats &write_stats(size_t bucket) const;
+
+    /**
+     * Compute the size bucket of a payload length.
+     *
+     * \param length Payload length
+     * \return Size bucket
+     */
+    static size_t size_bucket(uint32_t length);
+
+    /**
+     * Clear all the collected statistics.
+     */
+    void reset_stats();
+
+    void parse_begin();
+    void parse_end(uint8_t state);
+    void write_begin(uint32_t length);
+    void write_end(uint8_t result);
+    void erase_begin(uint8_t bank);
+    void erase_end(uint8_t bank);
+    void switch_begin(uint8_t from, uint8_t to);
+    void switch_end(uint8_t to);
+
+private:
+    static const size_t operations = 4;
+
+    Stats m_stats[operations];
+    Stats m_write_stats[SizeBuckets];
+    tick_t m_begin[operations];
+    uint32_t m_write_length;
+
+    void begin(Operation operation);
+
+    tick_t end(Operation operation);
+
+    static void clear(Stats &stats);
+
+    static void add(Stats &stats, tick_t duration);
+
+    static size_t bucket(uint64_t value, size_t buckets);
+};
+
+template<typename Clock, size_t Buckets, typename Next, size_t SizeBuckets>
+TimingTracer<Clock, Buckets, Next, SizeBuckets>::TimingTracer() {
+    reset_stats();
+}
+
+template<typename Clock, size_t Buckets, typename Next, size_t SizeBuckets>
+const typename TimingTracer<Clock, Buckets, Next, SizeBuckets>::Stats &TimingTracer<Clock, Buckets, Next, SizeBuckets>::stats(Operation operation) const {
+    return m_stats[(size_t) operation];
+}
+
+template<typename Clock, size_t Buckets, typename Next, size_t SizeBuckets>
+const typename TimingTracer<Clock, Buckets, Next, SizeBuckets>::Stats &TimingTracer<Clock, Buckets, Next, SizeBuckets>::write_stats(size_t bucket) const {
+    return m_write_stats[bucket];
+}
+
+template<typename Clock, size_t Buckets, typename Next, size_t SizeBuckets>
+size_t TimingTracer<Clock, Buckets, Next, SizeBuckets>::size_bucket(uint32_t length) {
+    return bucket(length, SizeBuckets);
+}
+
+template<typename Clock, size_t Buckets, typename Next, size_t SizeBuckets>
+void TimingTracer<Clock, Buckets, Next, SizeBuckets>::reset_stats() {
+    for (size_t i = 0; i < operations; i++) {
+        clear(m_stats[i]);
+        m_begin[i] = 0;
+    }
+    for (size_t i = 0; i < SizeBuckets; i++)
+        clear(m_write_stats[i]);
+    m_write_length = 0;
+}
+
+template<typename Clock, size_t Buckets, typename Next, size_t SizeBuckets>
+void TimingTracer<Clock, Buckets, Next, SizeBuckets>::begin(Operation operation) {
+    m_begin[(size_t) operation] = Clock::now();
+}
+
+template<typename Clock, size_t Buckets, typename Next, size_t SizeBuckets>
+typename TimingTracer<Clock, Buckets, Next, SizeBuckets>::tick_t TimingTracer<Clock, Buckets, Next, SizeBuckets>::end(Operation operation) {
+    // Unsigned arithmetic keeps the duration right when the clock wraps around
+    tick_t duration = (tick_t) (Clock::now() - m_begin[(size_t) operation]);
+
+    add(m_stats[(size_t) operation], duration);
+    return duration;
+}
+
+template<typename Clock, size_t Buckets, typename Next, size_t SizeBuckets>
+void TimingTracer<Clock, Buckets, Next, SizeBuckets>::clear(Stats &stats) {
+    stats.count = 0;
+    stats.min = stats.max = 0;
+    stats.total = 0;
+    std::fill(stats.histogram, stats.histogram + Buckets, 0);
+}
+
+template<typename Clock, size_t Buckets, typename Next, size_t SizeBuckets>
+void TimingTracer<Clock, Buckets, Next, SizeBuckets>::add(Stats &stats, tick_t duration) {
+    if (!stats.count || duration < stats.min)
+        stats.min = duration;
+    if (!stats.count || duration > stats.max)
+        stats.max = duration;
+    stats.count++;
+    stats.total += duration;
+    stats.histogram[bucket(duration, Buckets)]++;
+}
+
+template<typename Clock, size_t Buckets, typename Next, size_t SizeBuckets>
+size_t TimingTracer<Clock, Buckets, Next, SizeBuckets>::bucket(uint64_t value, size_t buckets) {
+    size_t bucket = 0;
+    for (; value > 1 && bucket < buckets - 1; value >>= 1)
+        bucket++;
+    return bucket;
+}
+
+template<typename Clock, size_t Buckets, typename Next, size_t SizeBuckets>
+void TimingTracer<Clock, Buckets, Next, SizeBuckets>::parse_begin() {
+    Next::parse_begin();
+    begin(Operation::PARSE);
+}
+
+template<typename Clock, size_t Buckets, typename Next, size_t SizeBuckets>
+void TimingTracer<Clock, Buckets, Next, SizeBuckets>::parse_end(uint8_t state) {
+    end(Operation::PARSE);
+    Next::parse_end(state);
+}
+
+template<typename Clock, size_t Buckets, typename Next, size_t SizeBuckets>
+void TimingTracer<Clock, Buckets, Next, SizeBuckets>::write_begin(uint32_t length) {
+    Next::write_begin(length);
+    m_write_length = length;
+    begin(Operation::WRITE);
+}
+
+template<typename Clock, size_t Buckets, typename Next, size_t SizeBuckets>
+void TimingTracer<Clock, Buckets, Next, SizeBuckets>::write_end(uint8_t result) {
+    add(m_write_stats[size_bucket(m_write_length)], end(Operation::WRITE));
+    Next::write_end(result);
+}
+
+template<typename Clock, size_t Buckets, typename Next, size_t SizeBuckets>
+void TimingTracer<Clock, Buckets, Next, SizeBuckets>::erase_begin(uint8_t bank) {
+    Next::erase_begin(bank);
+    begin(Operation::ERASE);
+}
+
+template<typename Clock, size_t Buckets, typename Next, size_t SizeBuckets>
+void TimingTracer<Clock, Buckets, Next, SizeBuckets>::erase_end(uint8_t bank) {
+    end(Operation::ERASE);
+    Next::erase_end(bank);
+}
+
+template<typename Clock, size_t Buckets, typename Next, size_t SizeBuckets>
+void TimingTracer<Clock, Buckets, Next, SizeBuckets>::switch_begin(uint8_t from, uint8_t to) {
+    Next::switch_begin(from, to);
+    begin(Operation::SWITCH);
+}
+
+template<typename Clock, size_t Buckets, typename Next, size_t SizeBuckets>
+void TimingTracer<Clock, Buckets, Next, SizeBuckets>::switch_end(uint8_t to) {
+    end(Operation::SWITCH);
+    Next::switch_end(to);
+}
+
+}
+
+#endif //TXFLASH_TIMING_HH
@@ -0,0 +1,298 @@
+#ifndef TXFLASH_TRACER_HH
+#define TXFLASH_TRACER_HH
+
+#include <cstddef>
+#include <cstdint>
+
+namespace txflash {
+
+/**
+ * Reason reported to tracers when corrupted flash content is detected.
+ */
+enum class Recovery : uint8_t {
+    BANK_HEADER = 1,   ///< Unexpected header at the beginning of a bank
+    OPEN_RECORD = 2,   ///< Record truncated by the end of the bank
+    RECORD_LENGTH = 3, ///< Record length exceeding the bank
+    RECORD_HEADER = 4, ///< Unexpected record header
+    TORN_RECORD = 5,   ///< Partially programmed record behind the last valid one
+    DIRTY_SPACE = 6,   ///< Programmed bytes in space expected to be erased (padding, free space or the standby bank)
+    PROGRAM_FAILED = 7 ///< Program failure reported by the bank, tearing the record being written
+};
+
+/**
+ * Tracer policy discarding every event, used by TxFlash by default.
+ *
+ * A tracer is any default constructible type exposing the methods below. TxFlash invokes them with integer arguments only,
+ * so that an implementation can forward them to a binary log, ITM/SWO stimulus ports or a host recorder without formatting.
+ * Banks are reported as 0 or 1, positions and lengths are truncated to 32 bits.
+ *
+ * @author Andrea Leofreddi
+ */
+struct NullTracer {
+    /**
+     * Flash parsing started.
+     */
+    void parse_begin() {
+    }
+
+    /**
+     * Flash parsing completed.
+     *
+     * \param state Parse outcome: 0 when empty, 1 when valid, 2 when invalid
+     */
+    void parse_end(uint8_t /* state */) {
+    }
+
+    /**
+     * A write started.
+     *
+     * \param length Payload length
+     */
+    void write_begin(uint32_t /* length */) {
+    }
+
+    /**
+     * A write completed.
+     *
+     * \param result Write outcome: 1 on success, 0 on failure
+     */
+    void write_end(uint8_t /* result */) {
+    }
+
+    /**
+     * A valid record has been visited while parsing.
+     *
+     * \param bank Bank containing the record
+     * \param position Record position
+     * \param length Record payload length
+     */
+    void record(uint8_t /* bank */, uint32_t /* position */, uint32_t /* length */) {
+    }
+
+    /**
+     * A chunk is going to be programmed.
+     *
+     * \param bank Target bank
+     * \param position Chunk position
+     * \param length Chunk length
+     */
+    void program(uint8_t /* bank */, uint32_t /* position */, uint32_t /* length */) {
+    }
+
+    /**
+     * A bank erase started.
+     *
+     * \param bank Erased bank
+     */
+    void erase_begin(uint8_t /* bank */) {
+    }
+
+    /**
+     * A bank erase completed.
+     *
+     * \param bank Erased bank
+     */
+    void erase_end(uint8_t /* bank */) {
+    }
+
+    /**
+     * A write is switching to the other bank.
+     *
+     * \param from Bank being left
+     * \param to Bank being switched to
+     */
+    void switch_begin(uint8_t /* from */, uint8_t /* to */) {
+    }
+
+    /**
+     * A bank switch completed.
+     *
+     * \param to Bank switched to
+     */
+    void switch_end(uint8_t /* to */) {
+    }
+
+    /**
+     * Corrupted content has been found. A torn record makes the next write switch bank, any other corruption makes the
+     * flash reset to the default payload when found by parsing, or gets repaired when found by scrubbing (see
+     * TxFlash::scrub_step()). A failed program makes the write retry on the other bank.
+     *
+     * \param reason Corruption kind
+     * \param bank Bank containing the corruption
+     * \param position Position of the corruption
+     */
+    void recovery(Recovery /* reason */, uint8_t /* bank */, uint32_t /* position */) {
+    }
+};
+
+/**
+ * Tracer storing the latest events into a fixed-size ring buffer, overwriting the oldest ones when full.
+ *
+ * \tparam Capacity Maximum number of stored events
+ *
+ * @author Andrea Leofreddi
+ */
+template<size_t Capacity>
+class RingBufferTracer {
+public:
+    static_assert(Capacity > 0, "ring buffer tracer needs a non-zero capacity");
+
+    enum class Event : uint8_t {
+        PARSE_BEGIN,
+        PARSE_END,
+        WRITE_BEGIN,
+        WRITE_END,
+        RECORD,
+        PROGRAM,
+        ERASE_BEGIN,
+        ERASE_END,
+        SWITCH_BEGIN,
+        SWITCH_END,
+        RECOVERY
+    };
+
+    /**
+     * A traced event. Arguments are event specific and follow NullTracer's methods argument order, unused ones are zero.
+     */
+    struct Entry {
+        Event event;
+        uint8_t bank;
+        uint32_t arg0;
+        uint32_t arg1;
+    };
+
+    RingBufferTracer() = default;
+
+    /**
+     * Retrieve the number of stored events.
+     *
+     * \return Number of events, up to Capacity
+     */
+    size_t size() const;
+
+    /**
+     * Retrieve the total number of events traced so far, including the overwritten ones.
+     *
+     * \return Number of traced events
+     */
+    uint32_t count() const;
+
+    /**
+     * Retrieve a stored event, from the oldest (0) to the newest (size() - 1).
+     *
+     * \param index Event index
+     * \return Stored event
+     */
+    const Entry &operator[](size_t index) const;
+
+    /**
+     * Discard all the stored events.
+     */
+    void clear();
+
+    void parse_begin();
+    void parse_end(uint8_t state);
+    void write_begin(uint32_t length);
+    void write_end(uint8_t result);
+    void record(uint8_t bank, uint32_t position, uint32_t length);
+    void program(uint8_t bank, uint32_t position, uint32_t length);
+    void erase_begin(uint8_t bank);
+    void erase_end(uint8_t bank);
+    void switch_begin(uint8_t from, uint8_t to);
+    void switch_end(uint8_t to);
+    void recovery(Recovery reason, uint8_t bank, uint32_t position);
+
+private:
+    Entry m_entries[Capacity];
+    uint32_t m_count = 0;
+
+    void push(Event event, uint8_t bank, uint32_t arg0, uint32_t arg1);
+};
+
+template<size_t Capacity>
+size_t RingBufferTracer<Capacity>::size() const {
+    return m_count < Capacity ? m_count : Capacity;
+}
+
+template<size_t Capacity>
+uint32_t RingBufferTracer<Capacity>::count() const {
+    return m_count;
+}
+
+template<size_t Capacity>
+const typename RingBufferTracer<Capacity>::Entry &RingBufferTracer<Capacity>::operator[](size_t index) const {
+    return m_entries[(m_count - size() + index) % Capacity];
+}
+
+template<size_t Capacity>
+void RingBufferTracer<Capacity>::clear() {
+    m_count = 0;
+}
+
+template<size_t Capacity>
+void RingBufferTracer<Capacity>::push(Event event, uint8_t bank, uint32_t arg0, uint32_t arg1) {
+    Entry &entry = m_entries[m_count++ % Capacity];
+    entry.event = event;
+    entry.bank = bank;
+    entry.arg0 = arg0;
+    entry.arg1 = arg1;
+}
+
+template<size_t Capacity>
+void RingBufferTracer<Capacity>::parse_begin() {
+    push(Event::PARSE_BEGIN, 0, 0, 0);
+}
+
+template<size_t Capacity>
+void RingBufferTracer<Capacity>::parse_end(uint8_t state) {
+    push(Event::PARSE_END, 0, state, 0);
+}
+
+template<size_t Capacity>
+void RingBufferTracer<Capacity>::write_begin(uint32_t length) {
+    push(Event::WRITE_BEGIN, 0, length, 0);
+}
+
+template<size_t Capacity>
+void RingBufferTracer<Capacity>::write_end(uint8_t result) {
+    push(Event::WRITE_END, 0, result, 0);
+}
+
+template<size_t Capacity>
+void RingBufferTracer<Capacity>::record(uint8_t bank, uint32_t position, uint32_t length) {
+    push(Event::RECORD, bank, position, length);
+}
+
+template<size_t Capacity>
+void RingBufferTracer<Capacity>::program(uint8_t bank, uint32_t position, uint32_t length) {
+    push(Event::PROGRAM, bank, position, length);
+}
+
+template<size_t Capacity>
+void RingBufferTracer<Capacity>::erase_begin(uint8_t bank) {
+    push(Event::ERASE_BEGIN, bank, 0, 0);
+}
+
+template<size_t Capacity>
+void RingBufferTracer<Capacity>::erase_end(uint8_t bank) {
+    push(Event::ERASE_END, bank, 0, 0);
+}
+
+template<size_t Capacity>
+void RingBufferTracer<Capacity>::switch_begin(uint8_t from, uint8_t to) {
+    push(Event::SWITCH_BEGIN, to, from, 0);
+}
+
+template<size_t Capacity>
+void RingBufferTracer<Capacity>::switch_end(uint8_t to) {
+    push(Event::SWITCH_END, to, 0, 0);
+}
+
+template<size_t Capacity>
+void RingBufferTracer<Capacity>::recovery(Recovery reason, uint8_t bank, uint32_t position) {
+    push(Event::RECOVERY, bank, (uint32_t) reason, position);
+}
+
+}
+
+#endif //TXFLASH_TRACER_HH
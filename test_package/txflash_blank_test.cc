@@ -0,0 +1,111 @@
+#include <cstring>
+#include <string>
+
+#include "catch.hpp"
+
+#include <txflash.hh>
+#include <txflash_blank.hh>
+#include <txflash_nor.hh>
+
+#define CLASS_METHOD_SHOULD(class_, member_function, test) #class_ "::" #member_function " should " test, "[" #class_ "::" #member_function "]" "[" #class_ "]"
+
+using txflash::BlankCheckFlashBank;
+using txflash::NorFlashBank;
+using txflash::NorFlashCounters;
+
+namespace {
+
+/**
+ * NOR bank hiding its memory mapped content, to exercise chunked blank checks.
+ */
+class UnmappedBank : public NorFlashBank<0x00, uint16_t> {
+public:
+    using NorFlashBank<0x00, uint16_t>::NorFlashBank;
+
+private:
+    using NorFlashBank<0x00, uint16_t>::data;
+};
+
+}
+
+TEST_CASE(CLASS_METHOD_SHOULD(txflash, is_blank, "find any non empty byte")) {
+    uint8_t data[67];
+    memset(data, 0xff, sizeof(data));
+
+    for (size_t offset = 0; offset < 8; offset++) {
+        for (size_t i = offset; i < sizeof(data); i++) {
+            REQUIRE(txflash::is_blank(data + offset, sizeof(data) - offset, 0xff));
+            data[i] = 0xfe;
+            REQUIRE(!txflash::is_blank(data + offset, sizeof(data) - offset, 0xff));
+            data[i] = 0xff;
+        }
+    }
+    REQUIRE(txflash::is_blank(data, 0, 0x00));
+}
+
+TEST_CASE(CLASS_METHOD_SHOULD(BlankCheckFlashBank, erase, "skip erasing blank banks")) {
+    uint8_t data[45];
+    const uint8_t payload = 0x12;
+    NorFlashCounters counters = {};
+
+    SECTION("memory mapped bank") {
+        static_assert(txflash::is_memory_mapped<NorFlashBank<0xff, uint16_t>>::value, "NorFlashBank is memory mapped");
+        static_assert(txflash::is_memory_mapped<BlankCheckFlashBank<NorFlashBank<0xff, uint16_t>>>::value, "wrapper is memory mapped");
+
+        memset(data, 0xff, sizeof(data));
+        BlankCheckFlashBank<NorFlashBank<0xff, uint16_t>> bank(NorFlashBank<0xff, uint16_t>(data, sizeof(data), &counters));
+
+        bank.erase();
+        REQUIRE(counters.erases == 0);
+
+        bank.write_chunk(44, &payload, 1);
+        REQUIRE(!bank.blank());
+        bank.erase();
+        REQUIRE(counters.erases == 1);
+        REQUIRE(bank.blank());
+    }
+
+    SECTION("chunked reads") {
+        static_assert(!txflash::is_memory_mapped<UnmappedBank>::value, "UnmappedBank is not memory mapped");
+        static_assert(!txflash::is_memory_mapped<BlankCheckFlashBank<UnmappedBank>>::value, "wrapper is not memory mapped");
+
+        memset(data, 0x00, sizeof(data));
+        BlankCheckFlashBank<UnmappedBank, 16> bank(UnmappedBank(data, sizeof(data), &counters));
+
+        bank.erase();
+        REQUIRE(counters.erases == 0);
+        REQUIRE(counters.reads == 3);
+
+        bank.write_chunk(44, &payload, 1);
+        bank.erase();
+        REQUIRE(counters.erases == 1);
+    }
+}
+
+TEST_CASE(CLASS_METHOD_SHOULD(BlankCheckFlashBank, erase, "spare erases on TxFlash bank switch")) {
+    uint8_t data0[24], data1[24];
+    NorFlashCounters counters0 = {}, counters1 = {};
+    using Bank = BlankCheckFlashBank<NorFlashBank<0xff, uint16_t>>;
+
+    memset(data0, 0xff, sizeof(data0));
+    memset(data1, 0xff, sizeof(data1));
+
+    auto tested = txflash::make_txflash(
+            Bank(NorFlashBank<0xff, uint16_t>(data0, sizeof(data0), &counters0)),
+            Bank(NorFlashBank<0xff, uint16_t>(data1, sizeof(data1), &counters1)),
+            "0000", 5
+    );
+
+    // Fill bank0, then switch to the blank bank1
+    for (int i = 0; i < 2; i++)
+        REQUIRE(tested.write("11111111", 9));
+    REQUIRE(counters0.erases + counters1.erases == 0);
+
+    // Switching back to bank0 requires erasing both
+    REQUIRE(tested.write("22222222", 9));
+    REQUIRE(counters0.erases == 1);
+    REQUIRE(counters1.erases == 1);
+
+    // Payloads are still viewed in place
+    REQUIRE(std::string(tested.view<char>()) == "22222222");
+}
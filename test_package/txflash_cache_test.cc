@@ -0,0 +1,84 @@
+#include <cstring>
+#include <string>
+
+#include "catch.hpp"
+
+#include <txflash.hh>
+#include <txflash_cache.hh>
+#include <txflash_nor.hh>
+
+#define CLASS_METHOD_SHOULD(class_, member_function, test) #class_ "::" #member_function " should " test, "[" #class_ "::" #member_function "]" "[" #class_ "]"
+
+using txflash::CachedFlashBank;
+using txflash::NorFlashBank;
+using txflash::NorFlashCounters;
+
+TEST_CASE(CLASS_METHOD_SHOULD(CachedFlashBank, read_chunk, "read through the cache")) {
+    uint8_t data[100], tmp[100];
+    NorFlashCounters counters = {};
+
+    for (size_t i = 0; i < sizeof(data); i++)
+        data[i] = (uint8_t) i;
+
+    CachedFlashBank<NorFlashBank<0xff, uint16_t>, 16, 2> bank(NorFlashBank<0xff, uint16_t>(data, sizeof(data), &counters));
+
+    SECTION("small reads hit the cached block") {
+        for (uint16_t position = 16; position < 32; position++) {
+            bank.read_chunk(position, tmp, 1);
+            REQUIRE(tmp[0] == position);
+        }
+        REQUIRE(counters.reads == 1);
+    }
+
+    SECTION("reads crossing blocks and the bank end") {
+        for (uint16_t position = 0; position < sizeof(data); position++) {
+            for (uint16_t length = 0; position + length <= sizeof(data); length += 7) {
+                memset(tmp, 0, sizeof(tmp));
+                bank.read_chunk(position, tmp, length);
+                REQUIRE(!memcmp(tmp, data + position, length));
+            }
+        }
+    }
+
+    SECTION("writes invalidate the affected blocks") {
+        const uint8_t payload = 0x00;
+
+        bank.read_chunk(20, tmp, 1);
+        bank.write_chunk(20, &payload, 1);
+        bank.read_chunk(20, tmp, 1);
+        REQUIRE(tmp[0] == 0x00);
+    }
+
+    SECTION("erases invalidate every block") {
+        bank.read_chunk(20, tmp, 1);
+        bank.erase();
+        bank.read_chunk(20, tmp, 1);
+        REQUIRE(tmp[0] == 0xff);
+    }
+}
+
+TEST_CASE(CLASS_METHOD_SHOULD(CachedFlashBank, read_chunk, "reduce reads while parsing")) {
+    uint8_t data0[256], data1[256], tmp[16];
+    NorFlashCounters counters0 = {}, counters1 = {};
+    using Bank = NorFlashBank<0xff, uint16_t>;
+    using Cached = CachedFlashBank<Bank, 64, 2>;
+
+    memset(data0, 0xff, sizeof(data0));
+    memset(data1, 0xff, sizeof(data1));
+    {
+        auto flash = txflash::make_txflash(Bank(data0, sizeof(data0)), Bank(data1, sizeof(data1)), "0000", 5);
+        for (int i = 0; i < 30; i++)
+            REQUIRE(flash.write(std::to_string(i).c_str(), 3));
+    }
+
+    auto uncached = txflash::make_txflash(Bank(data0, sizeof(data0), &counters0), Bank(data1, sizeof(data1)), "0000", 5);
+    auto cached = txflash::make_txflash(Cached(Bank(data0, sizeof(data0), &counters1)), Cached(Bank(data1, sizeof(data1))), "0000", 5);
+
+    // Both parsed the same record, the cached one with a fraction of the reads
+    REQUIRE(counters1.reads * 10 < counters0.reads);
+
+    cached.read(tmp);
+    REQUIRE(std::string((const char *) tmp) == "29");
+    uncached.read(tmp);
+    REQUIRE(std::string((const char *) tmp) == "29");
+}
@@ -0,0 +1,275 @@
+#include <cstring>
+
+#include "catch.hpp"
+
+#include <txflash.hh>
+#include <txflash_format.hh>
+#include <txflash_nor.hh>
+#include <txflash_tracer.hh>
+
+#define CLASS_METHOD_SHOULD(class_, member_function, test) #class_ "::" #member_function " should " test, "[" #class_ "::" #member_function "]" "[" #class_ "]"
+
+using txflash::NorFlashBank;
+using txflash::NullTracer;
+using txflash::RecordFormat;
+
+namespace {
+
+using Format = RecordFormat<0xff, uint16_t>;
+using Bank = NorFlashBank<0xff, uint16_t>;
+
+}
+
+TEST_CASE(CLASS_METHOD_SHOULD(RecordFormat, probe, "classify records")) {
+    uint8_t data[16];
+    memset(data, 0xff, sizeof(data));
+    Bank bank(data, sizeof(data));
+
+    SECTION("end of records") {
+        REQUIRE(Format::probe(bank, 0).status == Format::Status::END);
+    }
+
+    SECTION("valid record") {
+        const uint8_t record[] = {0x00, 3, 0, 'a', 'b', 'c'};
+        bank.write_chunk(0, record, sizeof(record));
+
+        Format::Record probed = Format::probe(bank, 0);
+        REQUIRE(probed.status == Format::Status::VALID);
+        REQUIRE(probed.position == 0);
+        REQUIRE(probed.length == 3);
+        REQUIRE(Format::size(probed.length) == 6);
+        REQUIRE(Format::payload(probed.position) == 3);
+    }
+
+    SECTION("torn record") {
+        const uint8_t length[] = {3, 0};
+        bank.write_chunk(1, length, sizeof(length));
+
+        REQUIRE(Format::probe(bank, 0).status == Format::Status::TORN);
+    }
+
+    SECTION("record exceeding the bank") {
+        const uint8_t record[] = {0x00, 14, 0};
+        bank.write_chunk(0, record, sizeof(record));
+
+        REQUIRE(Format::probe(bank, 0).status == Format::Status::BAD_LENGTH);
+    }
+
+    SECTION("record truncated by the end of the bank") {
+        const uint8_t header = 0x00;
+        bank.write_chunk(13, &header, 1);
+
+        REQUIRE(Format::probe(bank, 13).status == Format::Status::OPEN);
+    }
+
+    SECTION("bad header") {
+        const uint8_t header = 0x42;
+        bank.write_chunk(0, &header, 1);
+
+        REQUIRE(Format::probe(bank, 0).status == Format::Status::BAD_HEADER);
+    }
+
+    SECTION("header torn by a failed commit") {
+        const uint8_t record[] = {0x42, 3, 0, 'a', 'b', 'c'};
+        bank.write_chunk(0, record, sizeof(record));
+
+        REQUIRE(Format::probe(bank, 0).status == Format::Status::TORN);
+
+        // Followed by programmed flash, the header must be corrupted instead
+        bank.write_chunk(7, record, 1);
+        REQUIRE(Format::probe(bank, 0).status == Format::Status::BAD_HEADER);
+    }
+}
+
+TEST_CASE(CLASS_METHOD_SHOULD(RecordFormat, fits, "never overflow the position type")) {
+    REQUIRE(Format::fits(10, 6));
+    REQUIRE(!Format::fits(10, 7));
+    REQUIRE(!Format::fits(3, 0));
+    REQUIRE(!Format::fits(0xffff, 0xfffe));
+}
+
+TEST_CASE(CLASS_METHOD_SHOULD(RecordFormat, locate, "find the record written by TxFlash")) {
+    uint8_t data0[24], data1[24];
+    memset(data0, 0xff, sizeof(data0));
+    memset(data1, 0xff, sizeof(data1));
+
+    {
+        auto flash = txflash::make_txflash(Bank(data0, sizeof(data0)), Bank(data1, sizeof(data1)), "0000", 5);
+        REQUIRE(flash.write("111", 4));
+        REQUIRE(flash.write("22222", 6));
+    }
+
+    Bank bank0(data0, sizeof(data0)), bank1(data1, sizeof(data1));
+    Format::Cursor cursor;
+    NullTracer tracer;
+
+    REQUIRE(Format::locate(bank0, bank1, cursor, tracer) == Format::State::VALID);
+    REQUIRE(cursor.bank == 1);
+    REQUIRE(cursor.version == Format::version);
+    REQUIRE(cursor.read_position == 1);
+    REQUIRE(cursor.write_position == 10);
+    REQUIRE(Format::length(bank1, cursor.read_position) == 6);
+}
+
+TEST_CASE(CLASS_METHOD_SHOULD(RecordFormat, locate, "read unversioned banks and reject newer versions")) {
+    uint8_t data0[16], data1[16];
+    memset(data0, 0xff, sizeof(data0));
+    memset(data1, 0xff, sizeof(data1));
+
+    Bank bank0(data0, sizeof(data0)), bank1(data1, sizeof(data1));
+    Format::Cursor cursor;
+    NullTracer tracer;
+
+    SECTION("unversioned bank") {
+        const uint8_t record[] = {0x00, 3, 0, 'a', 'b', 'c'};
+        bank0.write_chunk(0, record, sizeof(record));
+
+        REQUIRE(Format::bank_version(bank0) == 0);
+        REQUIRE(Format::locate(bank0, bank1, cursor, tracer) == Format::State::VALID);
+        REQUIRE(cursor.version == 0);
+        REQUIRE(cursor.read_position == 0);
+        REQUIRE(cursor.write_position == 6);
+    }
+
+    SECTION("bank header without records") {
+        const Format::Header header = Format::bank_header(Format::version);
+        bank1.write_chunk(0, &header, 1);
+
+        REQUIRE(Format::bank_version(bank1) == Format::version);
+        REQUIRE(Format::locate(bank0, bank1, cursor, tracer) == Format::State::EMPTY);
+        REQUIRE(cursor.bank == 0);
+        REQUIRE(cursor.write_position == 0);
+    }
+
+    SECTION("newer version") {
+        const Format::Header header = Format::bank_header(Format::version + 1);
+        bank0.write_chunk(0, &header, 1);
+
+        REQUIRE(Format::locate(bank0, bank1, cursor, tracer) == Format::State::INVALID);
+    }
+}
+
+TEST_CASE(CLASS_METHOD_SHOULD(RecordFormat, locate, "skip headers torn by program failures")) {
+    uint8_t data0[16], data1[16];
+    memset(data0, 0xff, sizeof(data0));
+    memset(data1, 0xff, sizeof(data1));
+
+    Bank bank0(data0, sizeof(data0)), bank1(data1, sizeof(data1));
+    Format::Cursor cursor;
+    NullTracer tracer;
+
+    const uint8_t records[] = {(uint8_t) Format::bank_header(Format::version), 0x00, 3, 0, 'a', 'b', 'c'};
+    bank0.write_chunk(0, records, sizeof(records));
+
+    SECTION("torn first record") {
+        const uint8_t record[] = {(uint8_t) Format::bank_header(Format::version), 0x42, 1, 0, 'd'};
+        bank1.write_chunk(0, record, sizeof(record));
+
+        REQUIRE(Format::locate(bank0, bank1, cursor, tracer) == Format::State::VALID);
+        REQUIRE(cursor.bank == 0);
+        REQUIRE(cursor.read_position == 1);
+        REQUIRE(Format::matches(bank0, bank1, cursor));
+    }
+
+    SECTION("torn bank header") {
+        const uint8_t header = (uint8_t) Format::bank_header(Format::version) | 0x0c;
+        bank1.write_chunk(0, &header, 1);
+
+        REQUIRE(Format::bank_version(bank1) > Format::version);
+        REQUIRE(Format::locate(bank0, bank1, cursor, tracer) == Format::State::VALID);
+        REQUIRE(cursor.bank == 0);
+        REQUIRE(cursor.read_position == 1);
+        REQUIRE(Format::matches(bank0, bank1, cursor));
+
+        // Followed by programmed flash, the bank header must be corrupted instead
+        bank1.write_chunk(4, records, 1);
+        REQUIRE(Format::locate(bank0, bank1, cursor, tracer) == Format::State::INVALID);
+    }
+}
+
+TEST_CASE(CLASS_METHOD_SHOULD(RecordFormat, locate, "reject bank headers placing the first record past short banks")) {
+    uint8_t data0[16], data1[16];
+    memset(data0, 0xff, sizeof(data0));
+    memset(data1, 0xff, sizeof(data1));
+
+    Bank bank0(data0, sizeof(data0)), bank1(data1, sizeof(data1));
+    Format::Cursor cursor;
+    NullTracer tracer;
+
+    const uint8_t records[] = {(uint8_t) Format::bank_header(Format::version), 0x00, 3, 0, 'a', 'b', 'c'};
+    bank0.write_chunk(0, records, sizeof(records));
+
+    // Garbage decoding to the maximum alignment, followed by programmed flash
+    const uint8_t garbage[] = {(uint8_t) Format::bank_header(Format::version, Format::max_alignment), 0x00, 0x00};
+    REQUIRE(Format::first(Format::version, Format::max_alignment) >= sizeof(data1));
+    bank1.write_chunk(0, garbage, sizeof(garbage));
+
+    REQUIRE(Format::locate(bank0, bank1, cursor, tracer) == Format::State::INVALID);
+
+    cursor.bank = 0;
+    cursor.version = Format::version;
+    cursor.alignment = 1;
+    cursor.read_position = 1;
+    cursor.write_position = 7;
+    REQUIRE_FALSE(Format::matches(bank0, bank1, cursor));
+
+    // TxFlash recovers the default configuration
+    auto flash = txflash::make_txflash(Bank(data0, sizeof(data0)), Bank(data1, sizeof(data1)), "0", 2);
+    char payload[2];
+    flash.read(payload);
+    REQUIRE(payload[0] == '0');
+}
+
+TEST_CASE(CLASS_METHOD_SHOULD(RecordFormat, size, "pad records to the alignment")) {
+    // Header and length take 3 bytes, so the first record starts where its payload gets aligned
+    REQUIRE(Format::first(1, 1) == 1);
+    REQUIRE(Format::first(1, 4) == 1);
+    REQUIRE(Format::first(1, 8) == 5);
+    REQUIRE(Format::payload(Format::first(1, 8)) == 8);
+
+    REQUIRE(Format::size(5, 4) == 8);
+    REQUIRE(Format::size(6, 4) == 12);
+    REQUIRE(!Format::fits(12, 6, 4));
+    REQUIRE(Format::fits(13, 6, 4));
+    REQUIRE(!Format::fits(0xffff, 0xfffb, 4));
+
+    uint8_t data[16];
+    memset(data, 0xff, sizeof(data));
+    Bank bank(data, sizeof(data));
+
+    const Format::Header header = Format::bank_header(Format::version, 8);
+    bank.write_chunk(0, &header, 1);
+    REQUIRE(Format::bank_version(bank) == Format::version);
+    REQUIRE(Format::bank_alignment(bank) == 8);
+}
+
+TEST_CASE(CLASS_METHOD_SHOULD(RecordFormat, matches, "validate cursors against the banks")) {
+    uint8_t data0[24], data1[24];
+    memset(data0, 0xff, sizeof(data0));
+    memset(data1, 0xff, sizeof(data1));
+
+    auto flash = txflash::make_txflash(Bank(data0, sizeof(data0)), Bank(data1, sizeof(data1)), "0000", 5);
+    REQUIRE(flash.write("111", 4));
+
+    Bank bank0(data0, sizeof(data0)), bank1(data1, sizeof(data1));
+    Format::Cursor cursor;
+    NullTracer tracer;
+
+    REQUIRE(Format::locate(bank0, bank1, cursor, tracer) == Format::State::VALID);
+    REQUIRE(Format::matches(bank0, bank1, cursor));
+
+    SECTION("record appended after the cursor") {
+        REQUIRE(flash.write("2", 2));
+        REQUIRE(!Format::matches(bank0, bank1, cursor));
+    }
+
+    SECTION("other bank holding newer records") {
+        REQUIRE(flash.write("22222", 6));
+        REQUIRE(!Format::matches(bank0, bank1, cursor));
+    }
+
+    SECTION("cursor not pointing to the last record") {
+        cursor.read_position = 1;
+        REQUIRE(!Format::matches(bank0, bank1, cursor));
+    }
+}
@@ -0,0 +1,38 @@
+#include <cstring>
+
+#include "catch.hpp"
+
+#include <txflash.hh>
+#include <txflash_image.hh>
+#include <txflash_nor.hh>
+
+#define CLASS_METHOD_SHOULD(class_, member_function, test) #class_ "::" #member_function " should " test, "[" #class_ "::" #member_function "]" "[" #class_ "]"
+
+using txflash::NorFlashBank;
+using txflash::NorFlashCounters;
+
+TEST_CASE(CLASS_METHOD_SHOULD(txflash, build_image, "build images parsed without writing on first boot")) {
+    uint8_t data0[32], data1[32], tmp[32];
+    NorFlashCounters counters0 = {}, counters1 = {};
+
+    REQUIRE(txflash::build_image<0x00, uint32_t>(data0, data1, sizeof(data0), "device", 7));
+    for (uint8_t value : data1)
+        REQUIRE(value == 0x00);
+
+    NorFlashBank<0x00, uint32_t> bank0(data0, sizeof(data0), &counters0), bank1(data1, sizeof(data1), &counters1);
+    auto tested = txflash::make_txflash(std::move(bank0), std::move(bank1), "default", 8);
+
+    REQUIRE(tested.length() == 7);
+    tested.read(tmp);
+    REQUIRE(!strcmp((const char *) tmp, "device"));
+    REQUIRE(counters0.erases + counters1.erases == 0);
+    REQUIRE(counters0.programs + counters1.programs == 0);
+}
+
+TEST_CASE(CLASS_METHOD_SHOULD(txflash, build_image, "reject payloads not fitting the banks")) {
+    uint8_t data0[16], data1[16];
+
+    REQUIRE(txflash::build_image<0xff, uint16_t>(data0, data1, sizeof(data0), "0123456789", 11));
+    REQUIRE(!txflash::build_image<0xff, uint16_t>(data0, data1, sizeof(data0), "0123456789a", 12));
+    REQUIRE(!txflash::build_image<0xff, uint8_t>(data0, data1, 512, "0", 1));
+}
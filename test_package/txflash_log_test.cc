@@ -0,0 +1,100 @@
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "catch.hpp"
+
+#include <txflash_log.hh>
+#include <txflash_nor.hh>
+
+#define CLASS_METHOD_SHOULD(class_, member_function, test) #class_ "::" #member_function " should " test, "[" #class_ "::" #member_function "]" "[" #class_ "]"
+
+using txflash::NorFlashBank;
+using txflash::NorFlashCounters;
+using txflash::TxLog;
+
+namespace {
+
+using Bank = NorFlashBank<0xff, uint16_t>;
+using Log = TxLog<Bank, Bank, 16>;
+
+std::vector<std::string> records(const Log &log, std::vector<uint32_t> *sequences = nullptr) {
+    std::vector<std::string> result;
+    log.for_each([&](uint32_t sequence, const void *payload, uint16_t length) {
+        result.emplace_back((const char *) payload, length);
+        if (sequences)
+            sequences->push_back(sequence);
+    });
+    return result;
+}
+
+}
+
+TEST_CASE(CLASS_METHOD_SHOULD(TxLog, append, "append records and iterate them oldest first")) {
+    uint8_t data0[64], data1[64];
+    NorFlashCounters counters0 = {}, counters1 = {};
+
+    memset(data0, 0xff, sizeof(data0));
+    memset(data1, 0xff, sizeof(data1));
+
+    Log log(Bank(data0, sizeof(data0), &counters0), Bank(data1, sizeof(data1), &counters1));
+    REQUIRE(records(log).empty());
+    REQUIRE(Log::capacity == 9);
+
+    for (int i = 0; i < 6; i++)
+        REQUIRE(log.append(std::to_string(i).c_str(), 1));
+    REQUIRE(!log.append("0123456789", 10));
+
+    std::vector<uint32_t> sequences;
+    REQUIRE(records(log, &sequences) == std::vector<std::string>({"0", "1", "2", "3", "4", "5"}));
+    REQUIRE(sequences == std::vector<uint32_t>({0, 1, 2, 3, 4, 5}));
+
+    // Records are kept on reload
+    Log reloaded(Bank(data0, sizeof(data0)), Bank(data1, sizeof(data1)));
+    REQUIRE(records(reloaded) == records(log));
+    REQUIRE(reloaded.sequence() == 6);
+}
+
+TEST_CASE(CLASS_METHOD_SHOULD(TxLog, append, "erase the oldest bank when full")) {
+    uint8_t data0[64], data1[64];
+    NorFlashCounters counters0 = {}, counters1 = {};
+
+    memset(data0, 0xff, sizeof(data0));
+    memset(data1, 0xff, sizeof(data1));
+
+    Log log(Bank(data0, sizeof(data0), &counters0), Bank(data1, sizeof(data1), &counters1));
+    for (int i = 0; i < 12; i++)
+        REQUIRE(log.append(std::to_string(i % 10).c_str(), 1));
+
+    // 4 slots per bank: the first append erased bank0, then bank1, then bank0 again, dropping records 0-3
+    REQUIRE(counters0.erases == 2);
+    REQUIRE(counters1.erases == 1);
+    REQUIRE(records(log) == std::vector<std::string>({"4", "5", "6", "7", "8", "9", "0", "1"}));
+
+    Log reloaded(Bank(data0, sizeof(data0)), Bank(data1, sizeof(data1)));
+    REQUIRE(records(reloaded) == records(log));
+    REQUIRE(reloaded.sequence() == 12);
+}
+
+TEST_CASE(CLASS_METHOD_SHOULD(TxLog, TxLog, "skip torn slots")) {
+    uint8_t data0[64], data1[64];
+
+    memset(data0, 0xff, sizeof(data0));
+    memset(data1, 0xff, sizeof(data1));
+    {
+        Log log(Bank(data0, sizeof(data0)), Bank(data1, sizeof(data1)));
+        REQUIRE(log.append("a", 1));
+        REQUIRE(log.append("b", 1));
+    }
+
+    // Program the body of the 3rd slot but not its header
+    data0[2 * 16 + 1] = 2;
+
+    Log log(Bank(data0, sizeof(data0)), Bank(data1, sizeof(data1)));
+    REQUIRE(records(log) == std::vector<std::string>({"a", "b"}));
+    REQUIRE(log.append("c", 1));
+    REQUIRE(data0[3 * 16] == 0x00);
+
+    Log reloaded(Bank(data0, sizeof(data0)), Bank(data1, sizeof(data1)));
+    REQUIRE(records(reloaded) == std::vector<std::string>({"a", "b", "c"}));
+}
@@ -0,0 +1,75 @@
+#include <cstring>
+
+#include "catch.hpp"
+
+#include <txflash.hh>
+#include <txflash_nor.hh>
+
+#define CLASS_METHOD_SHOULD(class_, member_function, test) #class_ "::" #member_function " should " test, "[" #class_ "::" #member_function "]" "[" #class_ "]"
+
+using txflash::NorFlashBank;
+using txflash::NorFlashCounters;
+
+TEST_CASE(CLASS_METHOD_SHOULD(NorFlashBank, write_chunk, "only program bits away from the empty value")) {
+    uint8_t data[4] = {0xff, 0xff, 0x0f, 0xf0}, tmp[4];
+    const uint8_t payload[4] = {0x12, 0xff, 0xff, 0x3c};
+
+    SECTION("empty value 0xff") {
+        NorFlashBank<0xff> bank(data, sizeof(data));
+        bank.write_chunk(0, payload, sizeof(payload));
+        bank.read_chunk(0, tmp, sizeof(tmp));
+
+        REQUIRE(tmp[0] == 0x12);
+        REQUIRE(tmp[1] == 0xff);
+        REQUIRE(tmp[2] == 0x0f);
+        REQUIRE(tmp[3] == 0x30);
+    }
+
+    SECTION("empty value 0") {
+        NorFlashBank<0> bank(data, sizeof(data));
+        bank.write_chunk(0, payload, sizeof(payload));
+        bank.read_chunk(0, tmp, sizeof(tmp));
+
+        REQUIRE(tmp[0] == 0xff);
+        REQUIRE(tmp[1] == 0xff);
+        REQUIRE(tmp[2] == 0xff);
+        REQUIRE(tmp[3] == 0xfc);
+    }
+}
+
+TEST_CASE(CLASS_METHOD_SHOULD(NorFlashBank, erase, "restore the empty value")) {
+    uint8_t data[4] = {1, 2, 3, 4};
+    NorFlashBank<0xa5> bank(data, sizeof(data));
+
+    bank.erase();
+    for (uint8_t value : data)
+        REQUIRE(value == 0xa5);
+}
+
+TEST_CASE(CLASS_METHOD_SHOULD(NorFlashBank, NorFlashBank, "count operations when moved into TxFlash")) {
+    uint8_t data0[24], data1[24], tmp[8];
+    NorFlashCounters counters0 = {}, counters1 = {};
+
+    memset(data0, 0xff, sizeof(data0));
+    memset(data1, 0xff, sizeof(data1));
+
+    auto tested = txflash::make_txflash(
+            NorFlashBank<>(data0, sizeof(data0), &counters0),
+            NorFlashBank<>(data1, sizeof(data1), &counters1),
+            "0000", 5
+    );
+    REQUIRE(counters0.programs == 4);
+    REQUIRE(counters0.programmed_bytes == 1 + 1 + 4 + 5);
+    REQUIRE(counters0.erases == 0);
+
+    // Fill bank#0, then switch to bank#1
+    REQUIRE(tested.write("0001", 5));
+    REQUIRE(tested.write("0002", 5));
+    REQUIRE(counters0.programs == 7);
+    REQUIRE(counters1.erases == 1);
+    REQUIRE(counters1.programs == 4);
+
+    tested.read(tmp);
+    REQUIRE(std::string((const char *) tmp) == "0002");
+    REQUIRE(counters1.reads > 0);
+}
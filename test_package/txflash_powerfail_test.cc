@@ -0,0 +1,512 @@
+#include <chrono>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "catch.hpp"
+
+#include <txflash.hh>
+#include <txflash_blank.hh>
+#include <txflash_cache.hh>
+#include <txflash_log.hh>
+#include <txflash_nor.hh>
+
+#define CLASS_METHOD_SHOULD(class_, member_function, test) #class_ "::" #member_function " should " test, "[" #class_ "::" #member_function "]" "[" #class_ "]"
+
+using txflash::BlankCheckFlashBank;
+using txflash::CachedFlashBank;
+using txflash::NorFlashBank;
+using txflash::NorFlashCounters;
+using txflash::NullTracer;
+using txflash::TxFlash;
+using txflash::TxLog;
+
+namespace {
+
+/**
+ * Thrown when the power supply gets cut.
+ */
+struct PowerLoss {
+};
+
+/**
+ * A power supply shared by the banks, cutting power after a given number of program or erase steps.
+ */
+class PowerSupply {
+public:
+    /**
+     * Restore power and cut it again after the given number of steps.
+     */
+    void cut_after(uint64_t steps) {
+        m_budget = steps;
+        m_steps = 0;
+    }
+
+    /**
+     * Restore power permanently.
+     */
+    void restore() {
+        cut_after(UINT64_MAX);
+    }
+
+    /**
+     * Consume a step, returning false when the power is gone.
+     */
+    bool step() {
+        if (m_steps == m_budget)
+            return false;
+        m_steps++;
+        return true;
+    }
+
+    uint64_t steps() const {
+        return m_steps;
+    }
+
+    /**
+     * Make every n-th program step fail, or none when n is 0.
+     */
+    void fail_every(uint64_t n) {
+        m_fail_every = n;
+        m_programs = 0;
+    }
+
+    /**
+     * Count a program step, returning true when it fails.
+     */
+    bool program_fails() {
+        return m_fail_every && ++m_programs % m_fail_every == 0;
+    }
+
+private:
+    uint64_t m_budget = UINT64_MAX, m_steps = 0, m_fail_every = 0, m_programs = 0;
+};
+
+/**
+ * Bank wrapper splitting programs into aligned units of Granularity bytes and erases into ascending units of
+ * EraseGranularity bytes, each unit being a step on the power supply. When power is cut, the steps done so far stay
+ * programmed (erased) and PowerLoss is thrown. When a program step fails (see PowerSupply::fail_every()), the unit is
+ * left half programmed and false is returned.
+ */
+template<typename Bank, size_t Granularity, size_t EraseGranularity>
+class PowerFailBank {
+public:
+    using position_t = typename Bank::position_t;
+    static const uint8_t empty_value = Bank::empty_value;
+
+    PowerFailBank(Bank bank, PowerSupply *supply) : m_bank(bank), m_supply(supply) {
+    }
+
+    position_t length() const {
+        return m_bank.length();
+    }
+
+    void erase() {
+        // On power loss the units erased so far stay erased, while the rest of the bank is restored from a backup
+        std::vector<uint8_t> backup(m_bank.length());
+        m_bank.read_chunk(0, backup.data(), m_bank.length());
+
+        for (position_t position = 0; position < m_bank.length(); position += EraseGranularity) {
+            if (!m_supply->step()) {
+                m_bank.erase();
+                m_bank.write_chunk(position, backup.data() + position, m_bank.length() - position);
+                throw PowerLoss();
+            }
+        }
+        m_bank.erase();
+    }
+
+    void read_chunk(position_t position, void *destination, position_t length) const {
+        m_bank.read_chunk(position, destination, length);
+    }
+
+    bool write_chunk(position_t position, const void *payload, position_t length) {
+        const uint8_t *read = (const uint8_t *) payload;
+
+        for (position_t end = position + length; position < end;) {
+            position_t unit = std::min<position_t>(Granularity - position % Granularity, end - position);
+
+            if (!m_supply->step())
+                throw PowerLoss();
+
+            if (m_supply->program_fails()) {
+                // Low nibbles stay erased
+                uint8_t half[Granularity];
+                for (position_t i = 0; i < unit; i++)
+                    half[i] = (uint8_t) ((read[i] & 0xf0) | (empty_value & 0x0f));
+                m_bank.write_chunk(position, half, unit);
+                return false;
+            }
+
+            m_bank.write_chunk(position, read, unit);
+            position += unit;
+            read += unit;
+        }
+        return true;
+    }
+
+private:
+    Bank m_bank;
+    PowerSupply *m_supply;
+};
+
+/**
+ * Outcome of a power fail campaign.
+ */
+struct Campaign {
+    uint64_t cuts;
+    uint64_t max_recovery_erases;
+    std::chrono::nanoseconds max_recovery_time;
+};
+
+/**
+ * Features exercised by a power fail campaign, on top of plain writes.
+ */
+struct Features {
+    bool cursor_cache;   ///< Parse through a cursor cache surviving power cuts, as on warm resets
+    bool reserve;        ///< Keep a reserve, storing short payloads by emergency_write()
+    bool reset;          ///< Interleave reset() with writes
+    uint64_t fail_every; ///< Fail every n-th program step, so that records get retried on the other bank (0 for none)
+};
+
+/**
+ * A workload operation.
+ */
+struct Operation {
+    enum class Kind : uint8_t {
+        WRITE,
+        EMERGENCY_WRITE,
+        RESET
+    };
+
+    Kind kind;
+    std::string payload;
+};
+
+/**
+ * Bank adapters the campaign runs through.
+ */
+template<typename Bank>
+using Plain = Bank;
+
+template<typename Bank>
+using Cached = CachedFlashBank<Bank, 16, 2>;
+
+template<typename Bank>
+using BlankChecked = BlankCheckFlashBank<Bank, 16>;
+
+/**
+ * Apply an operation, returning true when a new record got committed.
+ */
+template<typename Flash>
+bool apply(Flash &flash, const Operation &operation) {
+    uint32_t version = flash.record_version();
+
+    switch (operation.kind) {
+        case Operation::Kind::WRITE:
+            return flash.write(operation.payload.data(), operation.payload.size());
+        case Operation::Kind::EMERGENCY_WRITE:
+            return flash.emergency_write(operation.payload.data(), operation.payload.size());
+        case Operation::Kind::RESET:
+            flash.reset();
+            break;
+    }
+    return flash.record_version() != version;
+}
+
+/**
+ * Runs a randomized write workload, cutting power at every possible step. After each cut, power is restored and the
+ * flash parsed again, requiring the recovered configuration to be either the last committed one or the one being
+ * written. The recovered flash must also accept and persist a further write.
+ *
+ * \tparam Adapter Bank adapter wrapping the power fail banks
+ * \tparam Alignment Payload alignment
+ */
+template<template<typename> class Adapter, size_t Alignment, size_t Granularity, size_t EraseGranularity>
+Campaign run_campaign(uint32_t seed, const Features &features = Features()) {
+    using Raw = PowerFailBank<NorFlashBank<0xff, uint16_t>, Granularity, EraseGranularity>;
+    using Bank = Adapter<Raw>;
+    using Flash = TxFlash<Bank, Bank, NullTracer, Alignment>;
+
+    const size_t bank_length = 64, writes = 24, emergency_length = 6;
+    const std::string initial = "default";
+
+    // Generate the workload
+    std::mt19937 random(seed);
+    std::vector<Operation> workload;
+    for (size_t i = 0; i < writes; i++) {
+        Operation operation = {Operation::Kind::WRITE, std::string(std::uniform_int_distribution<size_t>(0, 24)(random), '\0')};
+        for (char &c : operation.payload)
+            c = (char) std::uniform_int_distribution<int>('a', 'z')(random);
+
+        if (features.reset && std::uniform_int_distribution<int>(0, 5)(random) == 0)
+            operation = {Operation::Kind::RESET, initial};
+        else if (features.reserve && operation.payload.size() <= emergency_length)
+            operation.kind = Operation::Kind::EMERGENCY_WRITE;
+        workload.push_back(operation);
+    }
+
+    uint8_t data0[bank_length], data1[bank_length], tmp[bank_length];
+    PowerSupply supply;
+    NorFlashCounters counters0, counters1;
+    typename Flash::CursorCache cache;
+    Campaign campaign = {0, 0, std::chrono::nanoseconds(0)};
+
+    memset(&cache, 0, sizeof(cache));
+
+    auto make_flash = [&]() -> Flash {
+        Flash flash(
+                Bank(Raw(NorFlashBank<0xff, uint16_t>(data0, sizeof(data0), &counters0), &supply)),
+                Bank(Raw(NorFlashBank<0xff, uint16_t>(data1, sizeof(data1), &counters1), &supply)),
+                initial.data(), initial.size(), txflash::defer_init
+        );
+        if (features.cursor_cache)
+            flash.set_cursor_cache(&cache);
+        if (features.reserve)
+            flash.set_reserve(Flash::record_size(emergency_length));
+        flash.begin();
+        return flash;
+    };
+
+    auto load = [&](Flash &flash) {
+        flash.read(tmp);
+        return std::string((const char *) tmp, flash.length());
+    };
+
+    for (uint64_t cut = 0;; cut++) {
+        // The cursor cache is kept, so that it is stale
+        memset(data0, 0xff, sizeof(data0));
+        memset(data1, 0xff, sizeof(data1));
+        supply.cut_after(cut);
+        supply.fail_every(features.fail_every);
+
+        // Run the workload, keeping track of the committed and in-flight payloads
+        std::string committed = initial, pending = initial;
+        bool lost = false;
+        try {
+            Flash flash = make_flash();
+            for (const Operation &operation : workload) {
+                pending = operation.payload;
+                // Evaluated outside REQUIRE, which would swallow PowerLoss
+                bool written = apply(flash, operation);
+                // Failed programs are retried on the other bank, so writes only fail when the retry fails too
+                REQUIRE((written || features.fail_every));
+                if (written)
+                    committed = operation.payload;
+                REQUIRE(load(flash) == committed);
+            }
+        } catch (const PowerLoss &) {
+            lost = true;
+        }
+
+        if (!lost)
+            break;
+
+        // Restore power and recover
+        supply.restore();
+        supply.fail_every(0);
+        counters0 = counters1 = NorFlashCounters();
+
+        auto begin = std::chrono::steady_clock::now();
+        Flash flash = make_flash();
+        auto elapsed = std::chrono::steady_clock::now() - begin;
+
+        std::string recovered = load(flash);
+        INFO("cut after " << cut << " steps, committed '" << committed << "', pending '" << pending << "'");
+        REQUIRE((recovered == committed || recovered == pending));
+
+        campaign.cuts++;
+        campaign.max_recovery_erases = std::max<uint64_t>(campaign.max_recovery_erases, counters0.erases + counters1.erases);
+        campaign.max_recovery_time = std::max(campaign.max_recovery_time, std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed));
+
+        // The recovered flash must be fully functional
+        for (const std::string &payload : {std::string("recovered"), recovered + "!"}) {
+            REQUIRE(flash.write(payload.data(), payload.size()));
+            REQUIRE(load(flash) == payload);
+
+            Flash reloaded = make_flash();
+            REQUIRE(load(reloaded) == payload);
+        }
+    }
+
+    return campaign;
+}
+
+/**
+ * Runs an append workload on a TxLog, cutting power at every possible step. After each cut, the recovered log must hold
+ * increasing sequence numbers matching the appended payloads, ending with the last committed or the pending record, and
+ * must accept a further append.
+ */
+template<size_t Granularity, size_t EraseGranularity>
+uint64_t run_log_campaign() {
+    using Bank = PowerFailBank<NorFlashBank<0xff, uint16_t>, Granularity, EraseGranularity>;
+    using Log = TxLog<Bank, Bank, 16>;
+
+    const size_t bank_length = 64, appends = 20;
+    uint8_t data0[bank_length], data1[bank_length];
+    PowerSupply supply;
+    uint64_t cuts = 0;
+
+    auto make_log = [&]() {
+        return Log(
+                Bank(NorFlashBank<0xff, uint16_t>(data0, sizeof(data0)), &supply),
+                Bank(NorFlashBank<0xff, uint16_t>(data1, sizeof(data1)), &supply)
+        );
+    };
+
+    auto payload = [](uint32_t sequence) {
+        return std::string(sequence % 8 + 1, (char) ('a' + sequence % 26));
+    };
+
+    for (uint64_t cut = 0;; cut++) {
+        memset(data0, 0xff, sizeof(data0));
+        memset(data1, 0xff, sizeof(data1));
+        supply.cut_after(cut);
+
+        uint32_t committed = 0;
+        bool lost = false;
+        try {
+            Log log = make_log();
+            for (; committed < appends; committed++) {
+                // Evaluated outside REQUIRE, which would swallow PowerLoss
+                bool appended = log.append(payload(committed).data(), payload(committed).size());
+                REQUIRE(appended);
+            }
+        } catch (const PowerLoss &) {
+            lost = true;
+        }
+
+        if (!lost)
+            break;
+
+        supply.restore();
+        cuts++;
+
+        Log log = make_log();
+        std::vector<uint32_t> sequences;
+        log.for_each([&](uint32_t sequence, const void *data, uint16_t length) {
+            REQUIRE(std::string((const char *) data, length) == payload(sequence));
+            REQUIRE((sequences.empty() || sequence > sequences.back()));
+            sequences.push_back(sequence);
+        });
+
+        INFO("cut after " << cut << " steps, " << committed << " records committed");
+        if (committed)
+            REQUIRE((sequences.back() == committed - 1 || sequences.back() == committed));
+        else
+            REQUIRE(sequences.size() <= 1);
+
+        REQUIRE(log.append("!", 1));
+        std::string last;
+        make_log().for_each([&](uint32_t /* sequence */, const void *data, uint16_t length) {
+            last.assign((const char *) data, length);
+        });
+        REQUIRE(last == "!");
+    }
+
+    return cuts;
+}
+
+template<template<typename> class Adapter, size_t Alignment, size_t Granularity, size_t EraseGranularity>
+void require_atomic(const Features &features = Features()) {
+    for (uint32_t seed : {1, 2, 3}) {
+        Campaign campaign = run_campaign<Adapter, Alignment, Granularity, EraseGranularity>(seed, features);
+        REQUIRE(campaign.cuts > 0);
+        REQUIRE(campaign.max_recovery_erases <= 2);
+    }
+}
+
+template<template<typename> class Adapter, size_t Alignment, size_t Granularity, size_t EraseGranularity>
+void report(const char *name, const Features &features = Features()) {
+    Campaign worst = {0, 0, std::chrono::nanoseconds(0)};
+
+    for (uint32_t seed : {1, 2, 3}) {
+        Campaign campaign = run_campaign<Adapter, Alignment, Granularity, EraseGranularity>(seed, features);
+        worst.cuts += campaign.cuts;
+        worst.max_recovery_erases = std::max(worst.max_recovery_erases, campaign.max_recovery_erases);
+        worst.max_recovery_time = std::max(worst.max_recovery_time, campaign.max_recovery_time);
+    }
+
+    WARN(name << ": " << worst.cuts << " power cuts, worst case recovery "
+              << worst.max_recovery_time.count() << "ns with " << worst.max_recovery_erases << " erases");
+}
+
+}
+
+TEST_CASE(CLASS_METHOD_SHOULD(TxFlash, write, "recover old or new payload on power loss (byte programming)")) {
+    require_atomic<Plain, 1, 1, 1>();
+}
+
+TEST_CASE(CLASS_METHOD_SHOULD(TxFlash, write, "recover old or new payload on power loss (word programming)")) {
+    require_atomic<Plain, 1, 4, 16>();
+}
+
+TEST_CASE(CLASS_METHOD_SHOULD(TxFlash, write, "recover old or new payload on power loss (aligned payloads)")) {
+    require_atomic<Plain, 4, 1, 1>();
+    require_atomic<Plain, 8, 4, 16>();
+}
+
+TEST_CASE(CLASS_METHOD_SHOULD(TxFlash, write, "recover old or new payload on power loss (cursor cache)")) {
+    Features features = Features();
+    features.cursor_cache = true;
+
+    require_atomic<Plain, 1, 1, 1>(features);
+    require_atomic<Plain, 4, 4, 16>(features);
+}
+
+TEST_CASE(CLASS_METHOD_SHOULD(TxFlash, emergency_write, "recover old or new payload on power loss")) {
+    Features features = Features();
+    features.reserve = true;
+
+    require_atomic<Plain, 1, 1, 1>(features);
+    require_atomic<Plain, 4, 4, 16>(features);
+}
+
+TEST_CASE(CLASS_METHOD_SHOULD(TxFlash, reset, "recover old or new payload on power loss")) {
+    Features features = Features();
+    features.reset = true;
+
+    require_atomic<Plain, 1, 1, 1>(features);
+    require_atomic<Plain, 1, 4, 16>(features);
+}
+
+TEST_CASE(CLASS_METHOD_SHOULD(TxFlash, write, "recover old or new payload on power loss (bank adapters)")) {
+    require_atomic<Cached, 1, 1, 1>();
+    require_atomic<Cached, 4, 4, 16>();
+    require_atomic<BlankChecked, 1, 1, 1>();
+    require_atomic<BlankChecked, 4, 4, 16>();
+}
+
+TEST_CASE(CLASS_METHOD_SHOULD(TxFlash, write, "recover old or new payload on power loss (program failures)")) {
+    Features features = Features();
+
+    // Records take fewer program steps than the failure period, so that retries on the other bank succeed (but failed
+    // bank switches still fail writes)
+    features.fail_every = 37;
+    require_atomic<Plain, 1, 1, 1>(features);
+
+    features.fail_every = 11;
+    require_atomic<Plain, 1, 4, 16>(features);
+}
+
+TEST_CASE(CLASS_METHOD_SHOULD(TxFlash, write, "recover old or new payload on power loss (all features)")) {
+    Features features = {true, true, true, 37};
+
+    require_atomic<Cached, 4, 1, 1>(features);
+    require_atomic<BlankChecked, 4, 4, 16>(features);
+}
+
+TEST_CASE(CLASS_METHOD_SHOULD(TxLog, append, "keep committed records on power loss")) {
+    REQUIRE(run_log_campaign<1, 1>() > 0);
+    REQUIRE(run_log_campaign<4, 16>() > 0);
+}
+
+// Hidden, run with the [.benchmark] tag
+TEST_CASE("TxFlash::begin should report worst case recovery after power loss", "[.benchmark][TxFlash::begin][TxFlash]") {
+    Features features = {true, true, true, 0};
+
+    report<Plain, 1, 1, 1>("byte programming, byte erase");
+    report<Plain, 1, 4, 16>("word programming, 16 bytes erase");
+    report<Cached, 4, 4, 16>("word programming, 16 bytes erase, cached, all features", features);
+}
@@ -0,0 +1,86 @@
+#include <cstring>
+#include <string>
+
+#include "catch.hpp"
+
+#include <txflash.hh>
+#include <txflash_nor.hh>
+#include <txflash_reader.hh>
+
+#define CLASS_METHOD_SHOULD(class_, member_function, test) #class_ "::" #member_function " should " test, "[" #class_ "::" #member_function "]" "[" #class_ "]"
+
+using txflash::NorFlashBank;
+using txflash::TxFlashReader;
+
+namespace {
+
+using Bank = NorFlashBank<0xff, uint16_t>;
+
+/**
+ * Bank without write or erase support, as a bootloader would provide.
+ */
+class ReadOnlyBank {
+public:
+    static const uint8_t empty_value = 0xff;
+    using position_t = uint16_t;
+
+    ReadOnlyBank(const uint8_t *data, position_t length) : m_data(data), m_length(length) {
+    }
+
+    position_t length() const {
+        return m_length;
+    }
+
+    void read_chunk(position_t position, void *destination, position_t length) const {
+        memcpy(destination, m_data + position, length);
+    }
+
+private:
+    const uint8_t *m_data;
+    position_t m_length;
+};
+
+}
+
+TEST_CASE(CLASS_METHOD_SHOULD(TxFlashReader, read, "read the latest record")) {
+    uint8_t data0[24], data1[24], tmp[16];
+
+    memset(data0, 0xff, sizeof(data0));
+    memset(data1, 0xff, sizeof(data1));
+    {
+        auto flash = txflash::make_txflash(Bank(data0, sizeof(data0)), Bank(data1, sizeof(data1)), "0000", 5);
+        REQUIRE(flash.write("111", 4));
+        REQUIRE(flash.write("22222", 6));
+    }
+
+    TxFlashReader<ReadOnlyBank, ReadOnlyBank> reader(ReadOnlyBank(data0, sizeof(data0)), ReadOnlyBank(data1, sizeof(data1)));
+    REQUIRE(reader.valid());
+    REQUIRE(reader.length() == 6);
+    REQUIRE(reader.read(tmp, sizeof(tmp)) == 6);
+    REQUIRE(std::string((const char *) tmp) == "22222");
+
+    memset(tmp, 0, sizeof(tmp));
+    REQUIRE(reader.read(tmp, 2) == 2);
+    REQUIRE(std::string((const char *) tmp) == "22");
+}
+
+TEST_CASE(CLASS_METHOD_SHOULD(TxFlashReader, valid, "report empty or corrupted flash without modifying it")) {
+    uint8_t data0[24], data1[24], tmp[16];
+
+    memset(data0, 0xff, sizeof(data0));
+    memset(data1, 0xff, sizeof(data1));
+
+    SECTION("empty flash") {
+        TxFlashReader<ReadOnlyBank, ReadOnlyBank> reader(ReadOnlyBank(data0, sizeof(data0)), ReadOnlyBank(data1, sizeof(data1)));
+        REQUIRE(!reader.valid());
+        REQUIRE(reader.length() == 0);
+        REQUIRE(reader.read(tmp, sizeof(tmp)) == 0);
+    }
+
+    SECTION("corrupted flash") {
+        data0[0] = 0x42;
+        TxFlashReader<ReadOnlyBank, ReadOnlyBank> reader(ReadOnlyBank(data0, sizeof(data0)), ReadOnlyBank(data1, sizeof(data1)));
+        REQUIRE(!reader.valid());
+        REQUIRE(data0[0] == 0x42);
+    }
+}
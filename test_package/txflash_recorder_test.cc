@@ -0,0 +1,173 @@
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include "catch.hpp"
+
+#include <txflash.hh>
+#include <txflash_dummy.hh>
+#include <txflash_recorder.hh>
+
+#define CLASS_METHOD_SHOULD(class_, member_function, test) #class_ "::" #member_function " should " test, "[" #class_ "::" #member_function "]" "[" #class_ "]"
+
+using txflash::DummyFlashBank;
+using txflash::RecordingFlashBank;
+using txflash::TraceEvent;
+using txflash::TraceOp;
+using txflash::TraceReader;
+using txflash::TraceWriter;
+
+/**
+ * A sink appending to a memory buffer.
+ */
+struct VectorSink {
+    std::vector<uint8_t> data;
+
+    void write(const void *payload, size_t length) {
+        data.insert(data.end(), (const uint8_t *) payload, (const uint8_t *) payload + length);
+    }
+};
+
+using Bank = RecordingFlashBank<DummyFlashBank<0>, VectorSink>;
+
+TEST_CASE(CLASS_METHOD_SHOULD(RecordingFlashBank, RecordingFlashBank, "record bank operations")) {
+    uint8_t data0[20] = {0}, data1[20] = {0};
+    VectorSink sink;
+    TraceWriter<VectorSink> writer(sink);
+
+    {
+        Bank bank0(DummyFlashBank<0>(data0, sizeof(data0)), writer, 0);
+        Bank bank1(DummyFlashBank<0>(data1, sizeof(data1)), writer, 1);
+
+        auto tested = txflash::make_txflash(std::move(bank0), std::move(bank1), "0000", 5);
+        REQUIRE(tested.write("0001", 5));
+        REQUIRE(tested.write("0002", 5));
+    }
+
+    TraceReader reader(sink.data.data(), sink.data.size());
+    std::vector<TraceEvent> events;
+    for (TraceEvent event; reader.next(event);)
+        events.push_back(event);
+    REQUIRE(reader.valid());
+
+    REQUIRE(events[0].op == TraceOp::OPEN);
+    REQUIRE(events[0].bank == 0);
+    REQUIRE(events[0].length == 20);
+    REQUIRE(events[0].empty_value == 0);
+    REQUIRE(events[0].position_size == 2);
+    REQUIRE(events[1].op == TraceOp::OPEN);
+    REQUIRE(events[1].bank == 1);
+
+    // Bank headers are read first
+    REQUIRE(events[2].op == TraceOp::READ);
+    REQUIRE(events[2].position == 0);
+    REQUIRE(events[2].length == 1);
+
+    size_t erases = 0, writes = 0;
+    for (const TraceEvent &event : events) {
+        erases += event.op == TraceOp::ERASE;
+        writes += event.op == TraceOp::WRITE;
+    }
+    REQUIRE(erases == 1);
+    REQUIRE(writes == 11);
+
+    // The last write commits "0002" on bank#1
+    const TraceEvent &last = events.back();
+    REQUIRE(last.op == TraceOp::WRITE);
+    REQUIRE(last.bank == 1);
+    REQUIRE(last.position == 1);
+    REQUIRE(last.length == 1);
+    REQUIRE(last.data[0] == 1);
+}
+
+TEST_CASE(CLASS_METHOD_SHOULD(TraceReader, next, "replay a trace into identical banks")) {
+    uint8_t data0[64] = {0}, data1[64] = {0}, replay0[64] = {0}, replay1[64] = {0};
+    VectorSink sink;
+    TraceWriter<VectorSink> writer(sink);
+
+    {
+        Bank bank0(DummyFlashBank<0>(data0, sizeof(data0)), writer, 0);
+        Bank bank1(DummyFlashBank<0>(data1, sizeof(data1)), writer, 1);
+
+        auto tested = txflash::make_txflash(std::move(bank0), std::move(bank1), "0000", 5);
+        for (int i = 0; i < 20; i++) {
+            char payload[] = "payload #00";
+            payload[9] += i / 10;
+            payload[10] += i % 10;
+            REQUIRE(tested.write(payload, sizeof(payload)));
+        }
+    }
+
+    DummyFlashBank<0> bank0(replay0, sizeof(replay0)), bank1(replay1, sizeof(replay1));
+    TraceReader reader(sink.data.data(), sink.data.size());
+    REQUIRE(txflash::replay_trace(reader, bank0, bank1));
+
+    REQUIRE(memcmp(data0, replay0, sizeof(data0)) == 0);
+    REQUIRE(memcmp(data1, replay1, sizeof(data1)) == 0);
+}
+
+TEST_CASE(CLASS_METHOD_SHOULD(TraceReader, next, "reject malformed traces")) {
+    SECTION("bad magic") {
+        const uint8_t trace[] = {'T', 'X', 'F', 'X', 1};
+        TraceReader reader(trace, sizeof(trace));
+        TraceEvent event;
+
+        REQUIRE_FALSE(reader.next(event));
+        REQUIRE_FALSE(reader.valid());
+    }
+
+    SECTION("truncated write") {
+        const uint8_t trace[] = {'T', 'X', 'F', 'T', 1, (uint8_t) TraceOp::WRITE, 0, 0x80, 0x01, 4, 'a'};
+        TraceReader reader(trace, sizeof(trace));
+        TraceEvent event;
+
+        REQUIRE_FALSE(reader.next(event));
+        REQUIRE_FALSE(reader.valid());
+    }
+
+    SECTION("multi-byte positions") {
+        const uint8_t trace[] = {'T', 'X', 'F', 'T', 1, (uint8_t) TraceOp::READ, 1, 0x80, 0x01, 4};
+        TraceReader reader(trace, sizeof(trace));
+        TraceEvent event;
+
+        REQUIRE(reader.next(event));
+        REQUIRE(event.bank == 1);
+        REQUIRE(event.position == 128);
+        REQUIRE(event.length == 4);
+        REQUIRE_FALSE(reader.next(event));
+        REQUIRE(reader.valid());
+    }
+}
+
+TEST_CASE(CLASS_METHOD_SHOULD(TxFlash, replay_trace, "reject events outside the banks")) {
+    uint8_t data0[64], data1[64];
+    DummyFlashBank<0> bank0(data0, sizeof(data0)), bank1(data1, sizeof(data1));
+
+    memset(data0, 0, sizeof(data0));
+    memset(data1, 0, sizeof(data1));
+
+    SECTION("write past the end") {
+        const uint8_t trace[] = {'T', 'X', 'F', 'T', 1, (uint8_t) TraceOp::WRITE, 1, 62, 4, 'a', 'b', 'c', 'd'};
+        TraceReader reader(trace, sizeof(trace));
+
+        REQUIRE_FALSE(txflash::replay_trace(reader, bank0, bank1));
+    }
+
+    SECTION("read past the end") {
+        const uint8_t trace[] = {'T', 'X', 'F', 'T', 1, (uint8_t) TraceOp::READ, 0, 0x80, 0x01, 4};
+        TraceReader reader(trace, sizeof(trace));
+
+        REQUIRE_FALSE(txflash::replay_trace(reader, bank0, bank1));
+    }
+
+    SECTION("position + length overflow") {
+        const uint8_t trace[] = {'T', 'X', 'F', 'T', 1, (uint8_t) TraceOp::WRITE, 0,
+                                 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x01, 2, 'a', 'b'};
+        TraceReader reader(trace, sizeof(trace));
+
+        REQUIRE_FALSE(txflash::replay_trace(reader, bank0, bank1));
+    }
+
+    REQUIRE(std::all_of(data0, data0 + sizeof(data0), [](uint8_t value) { return value == 0; }));
+    REQUIRE(std::all_of(data1, data1 + sizeof(data1), [](uint8_t value) { return value == 0; }));
+}
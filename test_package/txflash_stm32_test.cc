@@ -0,0 +1,226 @@
+#include <cstring>
+#include <string>
+
+#include "catch.hpp"
+
+#include <txflash.hh>
+#include <txflash_log.hh>
+#include <txflash_stm32f4.hh>
+#include <txflash_stm32f7.hh>
+
+#define CLASS_METHOD_SHOULD(class_, member_function, test) #class_ "::" #member_function " should " test, "[" #class_ "::" #member_function "]" "[" #class_ "]"
+
+using txflash::Stm32f4FlashBank;
+using txflash::Stm32f7FlashBank;
+using txflash::TxFlash;
+
+namespace {
+
+using F4Bank0 = Stm32f4FlashBank<FLASH_SECTOR_1, 0x08004000, 0x4000>;
+using F4Bank1 = Stm32f4FlashBank<FLASH_SECTOR_2, 0x08008000, 0x4000>;
+using F7Bank0 = Stm32f7FlashBank<FLASH_SECTOR_1, 0x08008000, 0x8000>;
+using F7Bank1 = Stm32f7FlashBank<FLASH_SECTOR_2, 0x08010000, 0x8000>;
+
+const stm32_host::Counters &counters() {
+    return stm32_host::flash().counters;
+}
+
+}
+
+TEST_CASE(CLASS_METHOD_SHOULD(Stm32f4FlashBank, write_chunk, "program aligned words and unaligned ends as bytes")) {
+    stm32_host::reset(stm32_host::Family::F4);
+    F4Bank0 bank;
+    const uint8_t payload[13] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13};
+
+    // 3 leading bytes, 2 words, 2 trailing bytes
+    bank.write_chunk(1, payload, sizeof(payload));
+
+    REQUIRE(memcmp(bank.data() + 1, payload, sizeof(payload)) == 0);
+    REQUIRE(bank.data()[0] == 0xff);
+    REQUIRE(bank.data()[14] == 0xff);
+    REQUIRE(counters().programs[FLASH_TYPEPROGRAM_BYTE] == 5);
+    REQUIRE(counters().programs[FLASH_TYPEPROGRAM_WORD] == 2);
+    REQUIRE(counters().programmed_bytes == sizeof(payload));
+    REQUIRE(counters().errors == 0);
+    REQUIRE(counters().error_handler_calls == 0);
+
+    // The controller is unlocked once per chunk, and locked again
+    REQUIRE(counters().unlocks == 1);
+    REQUIRE(counters().locks == 1);
+    REQUIRE((FLASH->CR & FLASH_CR_LOCK) != 0);
+}
+
+TEST_CASE(CLASS_METHOD_SHOULD(Stm32f4FlashBank, write_chunk, "program a whole aligned chunk as words")) {
+    stm32_host::reset(stm32_host::Family::F4);
+    F4Bank0 bank;
+    const uint8_t payload[8] = {1, 2, 3, 4, 5, 6, 7, 8};
+
+    bank.write_chunk(0, payload, sizeof(payload));
+
+    REQUIRE(memcmp(bank.data(), payload, sizeof(payload)) == 0);
+    REQUIRE(counters().programs[FLASH_TYPEPROGRAM_BYTE] == 0);
+    REQUIRE(counters().programs[FLASH_TYPEPROGRAM_WORD] == 2);
+}
+
+TEST_CASE(CLASS_METHOD_SHOULD(Stm32f4FlashBank, erase, "erase only its own sector")) {
+    stm32_host::reset(stm32_host::Family::F4);
+    F4Bank0 bank0;
+    F4Bank1 bank1;
+    const uint8_t payload[4] = {0x12, 0x34, 0x56, 0x78};
+
+    bank0.write_chunk(0x3ffc, payload, sizeof(payload));
+    bank1.write_chunk(0, payload, sizeof(payload));
+
+    // Programming can only clear bits
+    const uint8_t other[4] = {0xf0, 0xf0, 0xf0, 0xf0};
+    bank1.write_chunk(0, other, sizeof(other));
+    REQUIRE(bank1.data()[0] == (0x12 & 0xf0));
+    REQUIRE(bank1.data()[3] == (0x78 & 0xf0));
+
+    bank0.erase();
+    REQUIRE(bank0.data()[0x3fff] == 0xff);
+    REQUIRE(bank1.data()[0] == (0x12 & 0xf0));
+    REQUIRE(counters().erases == 1);
+    REQUIRE(counters().busy_ns == 3 * stm32_host::program_ns() + stm32_host::erase_ns(0x4000));
+}
+
+TEST_CASE(CLASS_METHOD_SHOULD(Stm32f4FlashBank, write_chunk, "be rejected by a locked controller")) {
+    stm32_host::reset(stm32_host::Family::F4);
+
+    REQUIRE(HAL_FLASH_Program(FLASH_TYPEPROGRAM_WORD, 0x08004000, 0) == HAL_ERROR);
+    REQUIRE((FLASH->SR & FLASH_SR_PGSERR) != 0);
+
+    HAL_FLASH_Unlock();
+    REQUIRE(HAL_FLASH_Program(FLASH_TYPEPROGRAM_WORD, 0x08004002, 0) == HAL_ERROR);
+    REQUIRE((FLASH->SR & FLASH_SR_PGAERR) != 0);
+    HAL_FLASH_Lock();
+
+    REQUIRE(counters().errors == 2);
+    REQUIRE(stm32_host::flash().memory[0x4000] == 0xff);
+}
+
+TEST_CASE(CLASS_METHOD_SHOULD(TxFlash, write, "persist configurations on STM32F4 banks")) {
+    stm32_host::reset(stm32_host::Family::F4);
+    const char initial[] = "default", updated[] = "updated configuration";
+    char tmp[64];
+
+    {
+        TxFlash<F4Bank0, F4Bank1> flash{F4Bank0(), F4Bank1(), initial, sizeof(initial)};
+        for (int i = 0; i < 1000; i++)
+            REQUIRE(flash.write(i % 2 ? initial : updated, i % 2 ? sizeof(initial) : sizeof(updated)));
+    }
+
+    TxFlash<F4Bank0, F4Bank1> flash{F4Bank0(), F4Bank1()};
+    REQUIRE(flash.length() == sizeof(initial));
+    flash.read(tmp);
+    REQUIRE(std::string(tmp) == initial);
+
+    REQUIRE(counters().erases > 0);
+    REQUIRE(counters().errors == 0);
+    REQUIRE(counters().error_handler_calls == 0);
+    REQUIRE((FLASH->CR & FLASH_CR_LOCK) != 0);
+}
+
+TEST_CASE(CLASS_METHOD_SHOULD(TxFlash, write, "persist configurations on STM32F7 banks")) {
+    stm32_host::reset(stm32_host::Family::F7);
+    const char initial[] = "default", updated[] = "updated configuration";
+    char tmp[64];
+
+    {
+        TxFlash<F7Bank0, F7Bank1> flash{F7Bank0(), F7Bank1(), initial, sizeof(initial)};
+        for (int i = 0; i < 2000; i++)
+            REQUIRE(flash.write(i % 2 ? initial : updated, i % 2 ? sizeof(initial) : sizeof(updated)));
+    }
+
+    TxFlash<F7Bank0, F7Bank1> flash{F7Bank0(), F7Bank1()};
+    REQUIRE(flash.length() == sizeof(initial));
+    flash.read(tmp);
+    REQUIRE(std::string(tmp) == initial);
+
+    REQUIRE(counters().erases > 0);
+    REQUIRE(counters().errors == 0);
+    REQUIRE(counters().error_handler_calls == 0);
+}
+
+TEST_CASE(CLASS_METHOD_SHOULD(Stm32f4FlashBank, write_chunk, "report program failures")) {
+    stm32_host::reset(stm32_host::Family::F4);
+    stm32_host::wear(0x08004004, 4);
+    F4Bank0 bank;
+    const uint8_t payload[12] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12};
+
+    REQUIRE(bank.write_chunk(0, payload, 4));
+    REQUIRE_FALSE(bank.write_chunk(4, payload, sizeof(payload)));
+
+    // Programming stops at the failure
+    REQUIRE(counters().programs[FLASH_TYPEPROGRAM_WORD] == 1);
+    REQUIRE(bank.data()[8] == 0xff);
+    REQUIRE(counters().error_handler_calls == 0);
+    REQUIRE((FLASH->CR & FLASH_CR_LOCK) != 0);
+}
+
+TEST_CASE(CLASS_METHOD_SHOULD(TxFlash, write, "retry on the other bank when programming fails")) {
+    stm32_host::reset(stm32_host::Family::F4);
+    char tmp[64];
+
+    // Worn cells in the payload of the 3rd record: "default" takes 1 + 8 + 8 bytes after the bank header
+    stm32_host::wear(0x08004000 + 40, 4);
+
+    TxFlash<F4Bank0, F4Bank1> flash{F4Bank0(), F4Bank1(), "default", 8};
+    for (const char *payload : {"write 1", "write 2", "write 3", "write 4"}) {
+        REQUIRE(flash.write(payload, 8));
+        flash.read(tmp);
+        REQUIRE(std::string(tmp) == payload);
+    }
+    REQUIRE(counters().errors == 1);
+
+    TxFlash<F4Bank0, F4Bank1> reopened{F4Bank0(), F4Bank1()};
+    reopened.read(tmp);
+    REQUIRE(std::string(tmp) == "write 4");
+}
+
+TEST_CASE(CLASS_METHOD_SHOULD(TxFlash, write, "keep the configuration when both banks fail")) {
+    stm32_host::reset(stm32_host::Family::F4);
+    char tmp[64];
+
+    TxFlash<F4Bank0, F4Bank1> flash{F4Bank0(), F4Bank1(), "default", 8};
+    REQUIRE(flash.write("write 1", 8));
+
+    // Cells from the 3rd record of bank0 up to the bank header of bank1 can't be programmed
+    stm32_host::wear(0x08004000 + 40, 4);
+    stm32_host::flash().worn_end = 0x08008004;
+
+    REQUIRE_FALSE(flash.write("write 2", 8));
+    flash.read(tmp);
+    REQUIRE(std::string(tmp) == "write 1");
+
+    // Further writes fail within bounded time, instead of hanging
+    REQUIRE_FALSE(flash.write("write 3", 8));
+    REQUIRE(counters().error_handler_calls == 0);
+
+    TxFlash<F4Bank0, F4Bank1> reopened{F4Bank0(), F4Bank1()};
+    reopened.read(tmp);
+    REQUIRE(std::string(tmp) == "write 1");
+}
+
+TEST_CASE(CLASS_METHOD_SHOULD(TxLog, append, "skip slots failing to program on STM32F4 banks")) {
+    using Log = txflash::TxLog<F4Bank0, F4Bank1, 32>;
+
+    stm32_host::reset(stm32_host::Family::F4);
+
+    // The body of the 3rd slot can't be programmed
+    stm32_host::wear(0x08004000 + 2 * 32 + 8, 4);
+
+    Log log{F4Bank0(), F4Bank1()};
+    REQUIRE(log.append("1", 1));
+    REQUIRE(log.append("2", 1));
+    REQUIRE_FALSE(log.append("3", 1));
+    REQUIRE(log.append("4", 1));
+
+    std::string payloads;
+    Log reopened{F4Bank0(), F4Bank1()};
+    reopened.for_each([&](uint32_t /* sequence */, const void *payload, size_t length) {
+        payloads.append((const char *) payload, length);
+    });
+    REQUIRE(payloads == "124");
+    REQUIRE(reopened.sequence() == 4);
+}
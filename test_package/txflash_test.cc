@@ -1,10 +1,14 @@
 #include <cstring>
+#include <string>
+#include <vector>
 
 #include "catch.hpp"
 #include "fakeit.hpp"
 
 #include <txflash.hh>
 #include <txflash_dummy.hh>
+#include <txflash_image.hh>
+#include <txflash_nor.hh>
 
 #define CLASS_METHOD_SHOULD(class_, member_function, test) #class_ "::" #member_function " should " test, "[" #class_ "::" #member_function "]" "[" #class_ "]"
 
@@ -201,7 +205,7 @@ TEST_CASE(CLASS_METHOD_SHOULD(TxFlash, TxFlash, "wrap to next bank when full"))
     fakeit::VerifyNoOtherInvocations(Method(mock0, write_chunk));
     fakeit::Verify(
             Method(mock1, erase) +
-            Method(mock1, write_chunk) * 3
+            Method(mock1, write_chunk) * 4
     );
 
     REQUIRE(tested.length() == 5);
@@ -214,7 +218,7 @@ TEST_CASE(CLASS_METHOD_SHOULD(TxFlash, TxFlash, "wrap to next bank when full"))
     REQUIRE(tested.write("0003****", 9));
     fakeit::Verify(
             Method(mock0, erase)
-            + Method(mock0, write_chunk) * 3
+            + Method(mock0, write_chunk) * 4
             + Method(mock1, erase)
     );
     fakeit::VerifyNoOtherInvocations(Method(mock1, write_chunk));
@@ -442,11 +446,12 @@ TEST_CASE(CLASS_METHOD_SHOULD(TxFlash, TxFlash::reset, "reset the flash")) {
     tested.read(tmp);
     REQUIRE(std::string((const char *) tmp) == "0001");
 
+    // The default fits the current bank, so it gets appended without erasing
     tested.reset();
-    fakeit::Verify(Method(mock0, erase));
-    fakeit::Verify(Method(mock1, erase));
-    fakeit::Verify(Method(mock0, write_chunk));
-    fakeit::VerifyNoOtherInvocations(Method(mock1, write_chunk));
+    fakeit::VerifyNoOtherInvocations(Method(mock0, erase));
+    fakeit::VerifyNoOtherInvocations(Method(mock1, erase));
+    fakeit::Verify(Method(mock1, write_chunk));
+    fakeit::VerifyNoOtherInvocations(Method(mock0, write_chunk));
 
     tested.read(tmp);
     REQUIRE(std::string((const char *) tmp) == "!!!!");
@@ -480,3 +485,444 @@ TEST_CASE(CLASS_METHOD_SHOULD(TxFlash, TxFlash::reset, "quickstart demo")) {
     flash.read(tmp);
     REQUIRE(std::string((const char *) tmp) == new_conf);
 }
+
+TEST_CASE(CLASS_METHOD_SHOULD(TxFlash, TxFlash::set_reserve, "keep the reserve free for emergency writes")) {
+    uint8_t tmp[20], data0[20] = {0}, data1[20] = {0};
+
+    DummyFlashBank<0> bank0(data0, sizeof(data0));
+    DummyFlashBank<0> bank1(data1, sizeof(data1));
+
+    fakeit::Mock<DummyFlashBank<0>> mock0(mockMemoryBank(bank0)), mock1(mockMemoryBank(bank1));
+
+    auto tested = make_txflash(make_delegate(mock0.get()), make_delegate(mock1.get()), "0000", 5);
+    tested.set_reserve(tested.record_size(5));
+
+    SECTION("regular writes switch bank early") {
+        REQUIRE(tested.write("1111", 5));
+        fakeit::Verify(Method(mock1, erase));
+        fakeit::VerifyNoOtherInvocations(Method(mock0, erase));
+
+        tested.read(tmp);
+        REQUIRE(std::string((const char *) tmp) == "1111");
+    }
+
+    SECTION("emergency writes only program") {
+        REQUIRE(tested.emergency_write("!!!!", 5));
+        fakeit::VerifyNoOtherInvocations(Method(mock0, erase));
+        fakeit::VerifyNoOtherInvocations(Method(mock1, erase));
+        fakeit::VerifyNoOtherInvocations(Method(mock1, write_chunk));
+
+        tested.read(tmp);
+        REQUIRE(std::string((const char *) tmp) == "!!!!");
+    }
+}
+
+TEST_CASE(CLASS_METHOD_SHOULD(TxFlash, TxFlash::estimated_cost, "predict bank switches")) {
+    uint8_t data0[20] = {0}, data1[20] = {0};
+
+    auto tested = make_txflash(DummyFlashBank<0>(data0, sizeof(data0)), DummyFlashBank<0>(data1, sizeof(data1)), "0000", 5);
+
+    // The bank header and the default record take 9 bytes of bank0
+    REQUIRE(tested.free_space() == 11);
+    REQUIRE(!tested.will_switch(5));
+    REQUIRE(tested.will_switch(9));
+
+    auto cost = tested.estimated_cost(5);
+    REQUIRE(cost.programmed == 8);
+    REQUIRE(cost.erases == 0);
+
+    // A switch programs the bank header too
+    cost = tested.estimated_cost(9);
+    REQUIRE(cost.programmed == 13);
+    REQUIRE(cost.erases == 1);
+
+    cost = tested.estimated_cost(20);
+    REQUIRE(cost.programmed == 0);
+    REQUIRE(cost.erases == 0);
+
+    // Switching back to bank0 erases both banks
+    REQUIRE(tested.write("11111111", 9));
+    REQUIRE(tested.free_space() == 7);
+    cost = tested.estimated_cost(5);
+    REQUIRE(cost.programmed == 9);
+    REQUIRE(cost.erases == 2);
+
+    // Padding aligning payloads is left erased
+    uint8_t aligned0[32] = {0}, aligned1[32] = {0};
+    txflash::TxFlash<DummyFlashBank<0>, DummyFlashBank<0>, txflash::NullTracer, 8> aligned(
+            DummyFlashBank<0>(aligned0, sizeof(aligned0)), DummyFlashBank<0>(aligned1, sizeof(aligned1)), "0000", 5);
+
+    REQUIRE(aligned.record_size(6) == 16);
+    REQUIRE(aligned.estimated_cost(6).programmed == 9);
+}
+
+TEST_CASE(CLASS_METHOD_SHOULD(TxFlash, TxFlash::format_version, "upgrade unversioned banks on the next switch")) {
+    uint8_t tmp[20],
+            data0[20] = {1, 5, 0, '0', '0', '0', '0', '\0', 0},
+            data1[20] = {0};
+
+    auto tested = make_txflash(DummyFlashBank<0>(data0, sizeof(data0)), DummyFlashBank<0>(data1, sizeof(data1)), "!!!!", 5);
+
+    // The unversioned bank is read and appended to as it is
+    REQUIRE(tested.format_version() == 0);
+    tested.read(tmp);
+    REQUIRE(std::string((const char *) tmp) == "0000");
+
+    REQUIRE(tested.write("0001", 5));
+    REQUIRE(tested.format_version() == 0);
+    REQUIRE(data0[8] == 1);
+
+    // The switch to bank1 writes the newest record in the current format
+    REQUIRE(tested.write("0002", 5));
+    REQUIRE(tested.format_version() == 1);
+    REQUIRE(data1[0] == 3 /* version 1 bank header */);
+    REQUIRE(data1[1] == 1 /* record header */);
+
+    auto reopened = make_txflash(DummyFlashBank<0>(data0, sizeof(data0)), DummyFlashBank<0>(data1, sizeof(data1)), "!!!!", 5);
+    REQUIRE(reopened.format_version() == 1);
+    reopened.read(tmp);
+    REQUIRE(std::string((const char *) tmp) == "0002");
+}
+
+TEST_CASE(CLASS_METHOD_SHOULD(TxFlash, TxFlash::view, "access aligned payloads in place")) {
+    struct Conf {
+        uint32_t id;
+        uint16_t flags;
+    };
+
+    alignas(8) uint8_t data0[64] = {0}, data1[64] = {0};
+    const Conf defaults = {1, 2}, updated = {3, 4};
+
+    auto tested = make_txflash<txflash::NullTracer, 8>(
+            DummyFlashBank<0>(data0, sizeof(data0)), DummyFlashBank<0>(data1, sizeof(data1)), &defaults, sizeof(defaults)
+    );
+
+    // Bank header, then padding up to the first aligned payload
+    const Conf *view = tested.view<Conf>();
+    REQUIRE((const uint8_t *) view == data0 + 8);
+    REQUIRE(view->id == 1);
+    REQUIRE(view->flags == 2);
+
+    // Header, length and payload take 11 bytes, padded to 16
+    REQUIRE(tested.write(&updated, sizeof(updated)));
+    view = tested.view<Conf>();
+    REQUIRE((const uint8_t *) view == data0 + 8 + 16);
+    REQUIRE(view->id == 3);
+    REQUIRE(view->flags == 4);
+
+    // Payloads shorter than the type are not viewable
+    REQUIRE(tested.write("1", 1));
+    REQUIRE(tested.view<Conf>() == nullptr);
+}
+
+TEST_CASE(CLASS_METHOD_SHOULD(TxFlash, TxFlash::view, "align unaligned banks on the next switch")) {
+    alignas(4) uint8_t data0[20] = {1, 4, 0, 1, 0, 0, 0, 0},
+            data1[20] = {0};
+
+    auto tested = make_txflash<txflash::NullTracer, 4>(
+            DummyFlashBank<0>(data0, sizeof(data0)), DummyFlashBank<0>(data1, sizeof(data1)), nullptr, 0
+    );
+
+    // The record written before versioning is still read, though not in place
+    uint32_t value;
+    tested.read(&value);
+    REQUIRE(value == 1);
+    REQUIRE(tested.view<uint32_t>() == nullptr);
+
+    value = 2;
+    REQUIRE(tested.write(&value, sizeof(value)));
+    REQUIRE(tested.write(&value, sizeof(value)));
+    REQUIRE(tested.view<uint32_t>() == (const uint32_t *) (data1 + 4));
+    REQUIRE(*tested.view<uint32_t>() == 2);
+}
+
+TEST_CASE(CLASS_METHOD_SHOULD(TxFlash, TxFlash::begin, "defer flash parsing")) {
+    uint8_t tmp[20], data0[20], data1[20];
+    txflash::NorFlashCounters counters0 = {}, counters1 = {};
+
+    memset(data0, 0xff, sizeof(data0));
+    memset(data1, 0xff, sizeof(data1));
+
+    auto tested = make_txflash(
+            txflash::NorFlashBank<0xff, uint16_t>(data0, sizeof(data0), &counters0),
+            txflash::NorFlashBank<0xff, uint16_t>(data1, sizeof(data1), &counters1),
+            "0000", 5, txflash::defer_init
+    );
+    REQUIRE(counters0.reads + counters1.reads == 0);
+    REQUIRE(counters0.programs + counters1.programs == 0);
+
+    SECTION("explicitly") {
+        tested.begin();
+        REQUIRE(counters0.reads > 0);
+        REQUIRE(counters0.programs > 0);
+
+        uint32_t programs = counters0.programs, reads = counters0.reads;
+        tested.begin();
+        REQUIRE(counters0.programs == programs);
+        REQUIRE(counters0.reads == reads);
+    }
+
+    SECTION("on first write") {
+        REQUIRE(tested.write("0001", 5));
+        tested.read(tmp);
+        REQUIRE(std::string((const char *) tmp) == "0001");
+    }
+}
+
+TEST_CASE(CLASS_METHOD_SHOULD(TxFlash, TxFlash::set_cursor_cache, "skip the scan on warm resets")) {
+    using Bank = txflash::NorFlashBank<0xff, uint16_t>;
+    using Flash = txflash::TxFlash<Bank, Bank>;
+
+    uint8_t tmp[48], data0[64], data1[64];
+    txflash::NorFlashCounters counters = {};
+    Flash::CursorCache cache;
+
+    memset(data0, 0xff, sizeof(data0));
+    memset(data1, 0xff, sizeof(data1));
+
+    {
+        Flash flash(Bank(data0, sizeof(data0)), Bank(data1, sizeof(data1)), "0000", 5, txflash::defer_init);
+        flash.set_cursor_cache(&cache);
+        flash.begin();
+        for (const char *payload : {"0001", "0002", "0003", "0004", "0005"})
+            REQUIRE(flash.write(payload, 5));
+    }
+
+    auto reboot = [&]() {
+        counters = {};
+        Flash flash(Bank(data0, sizeof(data0), &counters), Bank(data1, sizeof(data1)), "0000", 5, txflash::defer_init);
+        flash.set_cursor_cache(&cache);
+        flash.begin();
+        flash.read(tmp);
+        return flash.length();
+    };
+
+    SECTION("valid cache") {
+        REQUIRE(reboot() == 5);
+        REQUIRE(std::string((const char *) tmp) == "0005");
+
+        // Bank headers, the first and last records and the empty header after it, instead of every record
+        REQUIRE(counters.reads < 16);
+    }
+
+    SECTION("garbage cache") {
+        memset(&cache, 0x5a, sizeof(cache));
+
+        REQUIRE(reboot() == 5);
+        REQUIRE(std::string((const char *) tmp) == "0005");
+        REQUIRE(counters.reads >= 16);
+    }
+
+    SECTION("flash written without the cache") {
+        {
+            Flash flash(Bank(data0, sizeof(data0)), Bank(data1, sizeof(data1)), "0000", 5);
+            REQUIRE(flash.write("0006", 5));
+        }
+
+        REQUIRE(reboot() == 5);
+        REQUIRE(std::string((const char *) tmp) == "0006");
+    }
+
+    SECTION("reprovisioned flash") {
+        // A single record, whose payload looks like a record at the cached read position followed by an empty header
+        uint8_t payload[48];
+        memset(payload, 'x', sizeof(payload));
+        memcpy(payload + 37, "\x00\x05\x00", 3);
+        memset(payload + 45, 0xff, 3);
+        REQUIRE(txflash::build_image<0xff, uint16_t>(data0, data1, sizeof(data0), payload, sizeof(payload)));
+
+        REQUIRE(reboot() == 48);
+        REQUIRE(memcmp(tmp, payload, sizeof(tmp)) == 0);
+    }
+}
+
+TEST_CASE(CLASS_METHOD_SHOULD(TxFlash, TxFlash::scrub_step, "repair latent corruption")) {
+    using Bank = txflash::NorFlashBank<0xff, uint16_t>;
+    using Flash = txflash::TxFlash<Bank, Bank>;
+
+    uint8_t tmp[20], data0[64], data1[64], copy0[64];
+
+    memset(data0, 0xff, sizeof(data0));
+    memset(data1, 0xff, sizeof(data1));
+
+    // Records at 1, 9 and 17, then free space from 25
+    Flash flash(Bank(data0, sizeof(data0)), Bank(data1, sizeof(data1)), "0000", 5);
+    REQUIRE(flash.write("0001", 5));
+    REQUIRE(flash.write("0002", 5));
+    memcpy(copy0, data0, sizeof(data0));
+
+    auto scrub = [&]() {
+        Flash::Health health;
+        int steps = 0;
+        do {
+            health = flash.scrub_step(16);
+            steps++;
+        } while (health == Flash::Health::SCRUBBING && steps < 100);
+        return health;
+    };
+
+    auto reboot = [&]() {
+        Flash reopened(Bank(data0, sizeof(data0)), Bank(data1, sizeof(data1)), "0000", 5);
+        reopened.read(tmp);
+        return std::string((const char *) tmp);
+    };
+
+    SECTION("healthy flash") {
+        // Bank header, 3 records, 39 free bytes and the standby bank take several steps
+        REQUIRE(flash.scrub_step(16) == Flash::Health::SCRUBBING);
+        REQUIRE(scrub() == Flash::Health::HEALTHY);
+        REQUIRE(memcmp(data0, copy0, sizeof(data0)) == 0);
+
+        // Passes start over
+        REQUIRE(scrub() == Flash::Health::HEALTHY);
+    }
+
+    SECTION("damaged older record") {
+        data0[9] = 0x55;
+
+        REQUIRE(scrub() == Flash::Health::REPAIRED);
+        flash.read(tmp);
+        REQUIRE(std::string((const char *) tmp) == "0002");
+        REQUIRE(data1[1] == 0x00 /* record header */);
+        REQUIRE(reboot() == "0002");
+        REQUIRE(scrub() == Flash::Health::HEALTHY);
+    }
+
+    SECTION("dirty free space") {
+        data0[40] = 0x7f;
+
+        REQUIRE(scrub() == Flash::Health::REPAIRED);
+        REQUIRE(reboot() == "0002");
+
+        REQUIRE(flash.write("0003", 5));
+        REQUIRE(reboot() == "0003");
+    }
+
+    SECTION("dirty standby bank") {
+        data1[50] = 0;
+
+        REQUIRE(scrub() == Flash::Health::REPAIRED);
+        REQUIRE(data1[50] == 0xff);
+        REQUIRE(memcmp(data0, copy0, sizeof(data0)) == 0);
+    }
+
+    SECTION("damaged current record") {
+        data0[18] = 0;
+
+        REQUIRE(scrub() == Flash::Health::DAMAGED);
+    }
+
+    SECTION("erased older record header before a torn tail") {
+        // The length of a record at 25 got programmed, giving up the rest of the bank
+        data0[26] = 5;
+        data0[27] = 0;
+        Flash reopened(Bank(data0, sizeof(data0)), Bank(data1, sizeof(data1)), "0000", 5);
+        data0[9] = 0xff;
+
+        Flash::Health health;
+        do {
+            health = reopened.scrub_step(16);
+        } while (health == Flash::Health::SCRUBBING);
+        REQUIRE(health == Flash::Health::REPAIRED);
+        REQUIRE(reboot() == "0002");
+    }
+}
+
+TEST_CASE(CLASS_METHOD_SHOULD(TxFlash, TxFlash::write_if, "fail on conflicting writes")) {
+    uint8_t tmp[20], data0[32] = {0}, data1[32] = {0};
+
+    auto tested = make_txflash(DummyFlashBank<0>(data0, sizeof(data0)), DummyFlashBank<0>(data1, sizeof(data1)), "0000", 5);
+
+    // Storing the default configuration counts as a write
+    REQUIRE(tested.record_version() == 1);
+
+    // Two tasks read the same version, the second write conflicts
+    uint32_t version_a = tested.record_version(), version_b = tested.record_version();
+    REQUIRE(tested.write_if(version_a, "000A", 5));
+    REQUIRE(tested.record_version() == 2);
+    REQUIRE_FALSE(tested.write_if(version_b, "000B", 5));
+    tested.read(tmp);
+    REQUIRE(std::string((const char *) tmp) == "000A");
+
+    // Retrying on the current version succeeds, across bank switches too
+    for (const char *payload : {"00AB", "0ABC", "ABCD"}) {
+        version_b = tested.record_version();
+        REQUIRE(tested.write_if(version_b, payload, 5));
+        REQUIRE(tested.record_version() == version_b + 1);
+    }
+    tested.read(tmp);
+    REQUIRE(std::string((const char *) tmp) == "ABCD");
+
+    tested.reset();
+    REQUIRE(tested.record_version() == 6);
+}
+
+TEST_CASE(CLASS_METHOD_SHOULD(TxFlash, TxFlash::subscribe, "notify configuration changes")) {
+    using Flash = txflash::TxFlash<DummyFlashBank<0>, DummyFlashBank<0>, txflash::NullTracer, 1, 2>;
+
+    struct Observed {
+        std::vector<Flash::Change::Cause> causes;
+        std::vector<uint32_t> versions;
+        std::string payload;
+
+        static void notify(void *context, const Flash::Change &change) {
+            Observed *observed = (Observed *) context;
+            observed->causes.push_back(change.cause);
+            observed->versions.push_back(change.version);
+            observed->payload.assign((const char *) change.payload, change.length);
+        }
+    };
+
+    uint8_t data0[32] = {0}, data1[32] = {0};
+    Observed first, second, third;
+
+    Flash tested(DummyFlashBank<0>(data0, sizeof(data0)), DummyFlashBank<0>(data1, sizeof(data1)), "0000", 5, txflash::defer_init);
+    REQUIRE(tested.subscribe(&Observed::notify, &first));
+    REQUIRE(tested.subscribe(&Observed::notify, &second));
+    REQUIRE_FALSE(tested.subscribe(&Observed::notify, &third));
+
+    // Storing the default configuration on empty flash
+    tested.begin();
+    REQUIRE(first.causes == std::vector<Flash::Change::Cause>{Flash::Change::Cause::RESET});
+    REQUIRE(first.payload == std::string("0000", 5));
+
+    // Payloads are viewed in place, across bank switches too
+    for (const char *payload : {"0001", "0002", "0003"}) {
+        REQUIRE(tested.write(payload, 5));
+        REQUIRE(first.payload == std::string(payload, 5));
+        REQUIRE(first.versions.back() == tested.record_version());
+    }
+
+    // Failed writes aren't notified
+    REQUIRE_FALSE(tested.write_if(0, "0004", 5));
+    REQUIRE(first.versions.size() == 4);
+
+    REQUIRE(tested.unsubscribe(&Observed::notify, &first));
+    REQUIRE_FALSE(tested.unsubscribe(&Observed::notify, &third));
+    tested.reset();
+    REQUIRE(first.versions.size() == 4);
+    REQUIRE(second.versions.size() == 5);
+    REQUIRE(second.causes.back() == Flash::Change::Cause::RESET);
+
+    // Bank1 holds records at 1 and 9: damaging the older one makes the scrubber move the current one to bank0
+    uint32_t version = tested.record_version();
+    data1[1] = 0x55;
+    Flash::Health health;
+    do {
+        health = tested.scrub_step(16);
+    } while (health == Flash::Health::SCRUBBING);
+
+    REQUIRE(health == Flash::Health::REPAIRED);
+    REQUIRE(second.causes.back() == Flash::Change::Cause::RELOCATION);
+    REQUIRE(second.versions.back() == version);
+    REQUIRE(second.payload == std::string("0000", 5));
+
+    // Corrupted flash rolls back to the default configuration on begin()
+    data0[0] = data1[0] = 0x55;
+    Flash recovered(DummyFlashBank<0>(data0, sizeof(data0)), DummyFlashBank<0>(data1, sizeof(data1)), "0000", 5, txflash::defer_init);
+    REQUIRE(recovered.subscribe(&Observed::notify, &third));
+    recovered.begin();
+    REQUIRE(third.causes == std::vector<Flash::Change::Cause>{Flash::Change::Cause::RECOVERY});
+    REQUIRE(third.versions.back() == 1);
+    REQUIRE(third.payload == std::string("0000", 5));
+}
@@ -0,0 +1,136 @@
+#include <cstring>
+
+#include "catch.hpp"
+
+#include <txflash.hh>
+#include <txflash_dummy.hh>
+#include <txflash_timing.hh>
+
+#define CLASS_METHOD_SHOULD(class_, member_function, test) #class_ "::" #member_function " should " test, "[" #class_ "::" #member_function "]" "[" #class_ "]"
+
+using txflash::DummyFlashBank;
+using txflash::Operation;
+using txflash::RingBufferTracer;
+using txflash::TimingTracer;
+
+/**
+ * A clock advancing by 10 ticks on every reading.
+ */
+struct StepClock {
+    using tick_t = uint32_t;
+
+    static tick_t ticks;
+
+    static tick_t now() {
+        return ticks += 10;
+    }
+};
+
+StepClock::tick_t StepClock::ticks = 0;
+
+TEST_CASE(CLASS_METHOD_SHOULD(TimingTracer, TimingTracer, "time parse, writes, erases and switches")) {
+    uint8_t data0[20], data1[20];
+
+    memset(data0, 0, sizeof(data0));
+    memset(data1, 0, sizeof(data1));
+
+    auto tested = txflash::make_txflash<TimingTracer<StepClock, 8>>(
+            DummyFlashBank<0>(data0, sizeof(data0)),
+            DummyFlashBank<0>(data1, sizeof(data1)),
+            "0000", 5
+    );
+
+    auto &tracer = tested.tracer();
+    REQUIRE(tracer.stats(Operation::PARSE).count == 1);
+    REQUIRE(tracer.stats(Operation::PARSE).min == 10);
+    REQUIRE(tracer.stats(Operation::PARSE).max == 10);
+    REQUIRE(tracer.stats(Operation::PARSE).histogram[3] == 1);
+    REQUIRE(tracer.stats(Operation::WRITE).count == 1);
+    REQUIRE(tracer.stats(Operation::SWITCH).count == 0);
+
+    REQUIRE(tested.write("0001", 5));
+    REQUIRE(tested.write("0002", 5));
+
+    // The last write switched to bank#1: write wraps switch, which wraps erase
+    REQUIRE(tracer.stats(Operation::WRITE).count == 3);
+    REQUIRE(tracer.stats(Operation::WRITE).min == 10);
+    REQUIRE(tracer.stats(Operation::WRITE).max == 50);
+    REQUIRE(tracer.stats(Operation::WRITE).total == 70);
+    REQUIRE(tracer.stats(Operation::SWITCH).count == 1);
+    REQUIRE(tracer.stats(Operation::SWITCH).max == 30);
+    REQUIRE(tracer.stats(Operation::ERASE).count == 1);
+    REQUIRE(tracer.stats(Operation::ERASE).max == 10);
+
+    tracer.reset_stats();
+    REQUIRE(tracer.stats(Operation::WRITE).count == 0);
+    REQUIRE(tracer.stats(Operation::WRITE).histogram[3] == 0);
+}
+
+TEST_CASE(CLASS_METHOD_SHOULD(TimingTracer, write_stats, "time writes per payload size")) {
+    using Tracer = TimingTracer<StepClock, 8, txflash::NullTracer, 4>;
+    uint8_t data0[64], data1[64];
+
+    memset(data0, 0, sizeof(data0));
+    memset(data1, 0, sizeof(data1));
+
+    REQUIRE(Tracer::size_bucket(0) == 0);
+    REQUIRE(Tracer::size_bucket(1) == 0);
+    REQUIRE(Tracer::size_bucket(2) == 1);
+    REQUIRE(Tracer::size_bucket(7) == 2);
+    REQUIRE(Tracer::size_bucket(8) == 3);
+    REQUIRE(Tracer::size_bucket(1000) == 3);
+
+    auto tested = txflash::make_txflash<Tracer>(
+            DummyFlashBank<0>(data0, sizeof(data0)),
+            DummyFlashBank<0>(data1, sizeof(data1)),
+            "0000", 5
+    );
+
+    auto &tracer = tested.tracer();
+    tracer.reset_stats();
+
+    REQUIRE(tested.write("1", 1));
+    REQUIRE(tested.write("22", 2));
+    REQUIRE(tested.write("333", 3));
+    REQUIRE(tested.write("0123456789", 10));
+
+    REQUIRE(tracer.write_stats(0).count == 1);
+    REQUIRE(tracer.write_stats(1).count == 2);
+    REQUIRE(tracer.write_stats(2).count == 0);
+    REQUIRE(tracer.write_stats(3).count == 1);
+    REQUIRE(tracer.write_stats(1).total == 20);
+    REQUIRE(tracer.write_stats(1).histogram[3] == 2);
+    REQUIRE(tracer.stats(Operation::WRITE).count == 4);
+
+    tracer.reset_stats();
+    REQUIRE(tracer.write_stats(1).count == 0);
+}
+
+TEST_CASE(CLASS_METHOD_SHOULD(TimingTracer, TimingTracer, "forward events to the next tracer")) {
+    TimingTracer<StepClock, 4, RingBufferTracer<4>> tracer;
+
+    tracer.erase_begin(1);
+    tracer.erase_end(1);
+
+    REQUIRE(tracer.size() == 2);
+    REQUIRE(tracer[0].event == RingBufferTracer<4>::Event::ERASE_BEGIN);
+    REQUIRE(tracer[1].event == RingBufferTracer<4>::Event::ERASE_END);
+    REQUIRE(tracer.stats(Operation::ERASE).count == 1);
+}
+
+TEST_CASE(CLASS_METHOD_SHOULD(TimingTracer, TimingTracer, "clamp long durations into the last bucket")) {
+    TimingTracer<StepClock, 2> tracer;
+
+    tracer.parse_begin();
+    StepClock::ticks += 1000;
+    tracer.parse_end(1);
+
+    REQUIRE(tracer.stats(Operation::PARSE).max == 1010);
+    REQUIRE(tracer.stats(Operation::PARSE).histogram[0] == 0);
+    REQUIRE(tracer.stats(Operation::PARSE).histogram[1] == 1);
+}
+
+TEST_CASE(CLASS_METHOD_SHOULD(SteadyClock, now, "be monotonic")) {
+    txflash::SteadyClock::tick_t first = txflash::SteadyClock::now();
+    REQUIRE(txflash::SteadyClock::now() >= first);
+}
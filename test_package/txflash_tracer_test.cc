@@ -0,0 +1,143 @@
+#include <cstring>
+
+#include "catch.hpp"
+
+#include <txflash.hh>
+#include <txflash_dummy.hh>
+#include <txflash_tracer.hh>
+
+#define CLASS_METHOD_SHOULD(class_, member_function, test) #class_ "::" #member_function " should " test, "[" #class_ "::" #member_function "]" "[" #class_ "]"
+
+using txflash::DummyFlashBank;
+using txflash::RingBufferTracer;
+using txflash::Recovery;
+
+using Tracer = RingBufferTracer<32>;
+using Event = Tracer::Event;
+
+TEST_CASE(CLASS_METHOD_SHOULD(RingBufferTracer, RingBufferTracer, "keep the latest events")) {
+    RingBufferTracer<2> tracer;
+
+    REQUIRE(tracer.size() == 0);
+
+    tracer.erase_begin(0);
+    tracer.erase_end(0);
+    tracer.erase_begin(1);
+
+    REQUIRE(tracer.count() == 3);
+    REQUIRE(tracer.size() == 2);
+    REQUIRE(tracer[0].event == RingBufferTracer<2>::Event::ERASE_END);
+    REQUIRE(tracer[1].event == RingBufferTracer<2>::Event::ERASE_BEGIN);
+    REQUIRE(tracer[1].bank == 1);
+
+    tracer.clear();
+    REQUIRE(tracer.size() == 0);
+}
+
+TEST_CASE(CLASS_METHOD_SHOULD(TxFlash, TxFlash, "trace parse and program events")) {
+    uint8_t data0[20], data1[20];
+
+    memset(data0, 0, sizeof(data0));
+    memset(data1, 0, sizeof(data1));
+
+    auto tested = txflash::make_txflash<Tracer>(
+            DummyFlashBank<0>(data0, sizeof(data0)),
+            DummyFlashBank<0>(data1, sizeof(data1)),
+            "0000", 5
+    );
+
+    Tracer &tracer = tested.tracer();
+    REQUIRE(tracer.size() == 8);
+    REQUIRE(tracer[0].event == Event::PARSE_BEGIN);
+    REQUIRE(tracer[1].event == Event::PARSE_END);
+    REQUIRE(tracer[1].arg0 == 0 /* empty */);
+    REQUIRE(tracer[2].event == Event::WRITE_BEGIN);
+    REQUIRE(tracer[2].arg0 == 5);
+
+    // Bank header, length, payload and header
+    REQUIRE(tracer[3].event == Event::PROGRAM);
+    REQUIRE(tracer[3].arg0 == 0);
+    REQUIRE(tracer[3].arg1 == 1);
+    REQUIRE(tracer[4].event == Event::PROGRAM);
+    REQUIRE(tracer[4].arg0 == 2);
+    REQUIRE(tracer[5].event == Event::PROGRAM);
+    REQUIRE(tracer[5].arg1 == 5);
+    REQUIRE(tracer[6].event == Event::PROGRAM);
+    REQUIRE(tracer[6].arg0 == 1);
+    REQUIRE(tracer[6].arg1 == 1);
+
+    REQUIRE(tracer[7].event == Event::WRITE_END);
+    REQUIRE(tracer[7].arg0 == 1);
+}
+
+TEST_CASE(CLASS_METHOD_SHOULD(TxFlash, TxFlash, "trace bank switches")) {
+    uint8_t data0[20], data1[20];
+
+    memset(data0, 0, sizeof(data0));
+    memset(data1, 0, sizeof(data1));
+
+    auto tested = txflash::make_txflash<Tracer>(
+            DummyFlashBank<0>(data0, sizeof(data0)),
+            DummyFlashBank<0>(data1, sizeof(data1)),
+            "0000", 5
+    );
+
+    REQUIRE(tested.write("0001", 5));
+    tested.tracer().clear();
+
+    REQUIRE(tested.write("0002", 5));
+
+    Tracer &tracer = tested.tracer();
+    REQUIRE(tracer.size() == 10);
+    REQUIRE(tracer[0].event == Event::WRITE_BEGIN);
+    REQUIRE(tracer[1].event == Event::SWITCH_BEGIN);
+    REQUIRE(tracer[1].arg0 == 0);
+    REQUIRE(tracer[1].bank == 1);
+    REQUIRE(tracer[2].event == Event::ERASE_BEGIN);
+    REQUIRE(tracer[2].bank == 1);
+    REQUIRE(tracer[3].event == Event::ERASE_END);
+    REQUIRE(tracer[8].event == Event::SWITCH_END);
+    REQUIRE(tracer[8].bank == 1);
+    REQUIRE(tracer[9].event == Event::WRITE_END);
+}
+
+TEST_CASE(CLASS_METHOD_SHOULD(TxFlash, TxFlash, "trace parsed records")) {
+    uint8_t data0[20] = {1, 5, 0, '0', '0', '0', '0', '\0', 1, 1, 0, '1', 0},
+            data1[20] = {0};
+
+    auto tested = txflash::make_txflash<Tracer>(
+            DummyFlashBank<0>(data0, sizeof(data0)),
+            DummyFlashBank<0>(data1, sizeof(data1)),
+            "!!!!", 5
+    );
+
+    Tracer &tracer = tested.tracer();
+    REQUIRE(tracer.size() == 4);
+    REQUIRE(tracer[1].event == Event::RECORD);
+    REQUIRE(tracer[1].arg0 == 0);
+    REQUIRE(tracer[1].arg1 == 5);
+    REQUIRE(tracer[2].event == Event::RECORD);
+    REQUIRE(tracer[2].arg0 == 8);
+    REQUIRE(tracer[2].arg1 == 1);
+    REQUIRE(tracer[3].event == Event::PARSE_END);
+    REQUIRE(tracer[3].arg0 == 1 /* valid */);
+}
+
+TEST_CASE(CLASS_METHOD_SHOULD(TxFlash, TxFlash, "trace recovery")) {
+    uint8_t data0[20] = {1, 5, 0, '0', '0', '0', '0', '\0', 7},
+            data1[20] = {0};
+
+    auto tested = txflash::make_txflash<Tracer>(
+            DummyFlashBank<0>(data0, sizeof(data0)),
+            DummyFlashBank<0>(data1, sizeof(data1)),
+            "!!!!", 5
+    );
+
+    Tracer &tracer = tested.tracer();
+    REQUIRE(tracer[2].event == Event::RECOVERY);
+    REQUIRE(tracer[2].arg0 == (uint32_t) Recovery::RECORD_HEADER);
+    REQUIRE(tracer[2].arg1 == 8);
+    REQUIRE(tracer[3].event == Event::PARSE_END);
+    REQUIRE(tracer[3].arg0 == 2 /* invalid */);
+    REQUIRE(tracer[4].event == Event::ERASE_BEGIN);
+}
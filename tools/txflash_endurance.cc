@@ -0,0 +1,127 @@
+/**
+ * TxFlash lifetime/endurance projection tool.
+ *
+ * Runs an accelerated write workload through TxFlash over simulated NOR banks, then projects the observed erase counts
+ * onto the given write rate, printing as CSV the erases per sector per year, the time between bank switches and the
+ * years to reach the sector endurance limit (infinite values are printed as inf). Record overhead and bank switch
+ * behavior are accounted for, since the real TxFlash code runs the workload.
+ *
+ * Usage: txflash_endurance [--bank-length=N] [--payload=MIN[:MAX]] [--rate=WRITES_PER_DAY] [--endurance=CYCLES]
+ *                          [--writes=N] [--seed=N]
+ *
+ * @author Andrea Leofreddi
+ */
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include <txflash.hh>
+#include <txflash_nor.hh>
+
+namespace {
+
+using txflash::NorFlashBank;
+using txflash::NorFlashCounters;
+
+struct Options {
+    uint32_t bank_length = 0x4000;
+    uint32_t min_payload = 64, max_payload = 64;
+    double rate = 24;
+    double endurance = 10000;
+    uint64_t writes = 100000;
+    uint32_t seed = 1;
+};
+
+/**
+ * Tracer counting bank switches.
+ */
+struct SwitchCounter : txflash::NullTracer {
+    uint64_t switches = 0;
+
+    void switch_begin(uint8_t /* from */, uint8_t /* to */) {
+        switches++;
+    }
+};
+
+bool parse_options(int argc, char **argv, Options &options) {
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        char *end = nullptr;
+
+        if (!strncmp(arg, "--bank-length=", 14)) {
+            options.bank_length = strtoul(arg + 14, &end, 0);
+        } else if (!strncmp(arg, "--payload=", 10)) {
+            options.min_payload = options.max_payload = strtoul(arg + 10, &end, 0);
+            if (*end == ':')
+                options.max_payload = strtoul(end + 1, &end, 0);
+        } else if (!strncmp(arg, "--rate=", 7)) {
+            options.rate = strtod(arg + 7, &end);
+        } else if (!strncmp(arg, "--endurance=", 12)) {
+            options.endurance = strtod(arg + 12, &end);
+        } else if (!strncmp(arg, "--writes=", 9)) {
+            options.writes = strtoull(arg + 9, &end, 0);
+        } else if (!strncmp(arg, "--seed=", 7)) {
+            options.seed = strtoul(arg + 7, &end, 0);
+        }
+
+        if (!end || *end)
+            return false;
+    }
+
+    return options.bank_length && options.min_payload <= options.max_payload && options.rate > 0 && options.writes;
+}
+
+}
+
+int main(int argc, char **argv) {
+    using Bank = NorFlashBank<0xff, uint32_t>;
+
+    Options options;
+    if (!parse_options(argc, argv, options)) {
+        fprintf(stderr, "Usage: %s [--bank-length=N] [--payload=MIN[:MAX]] [--rate=WRITES_PER_DAY] [--endurance=CYCLES] "
+                        "[--writes=N] [--seed=N]\n", argv[0]);
+        return 2;
+    }
+
+    std::vector<uint8_t> data0(options.bank_length, 0xff), data1(options.bank_length, 0xff);
+    std::vector<uint8_t> payload(options.max_payload);
+    NorFlashCounters counters0 = {}, counters1 = {};
+    std::mt19937 random(options.seed);
+    std::uniform_int_distribution<uint32_t> length(options.min_payload, options.max_payload);
+
+    txflash::TxFlash<Bank, Bank, SwitchCounter> flash(
+            Bank(data0.data(), data0.size(), &counters0),
+            Bank(data1.data(), data1.size(), &counters1),
+            payload.data(), options.min_payload
+    );
+
+    for (uint64_t i = 0; i < options.writes; i++) {
+        for (uint8_t &byte : payload)
+            byte = (uint8_t) random();
+
+        if (!flash.write(payload.data(), length(random))) {
+            fprintf(stderr, "Payloads up to %u bytes do not fit %u bytes banks\n", options.max_payload, options.bank_length);
+            return 1;
+        }
+    }
+
+    double years = options.writes / options.rate / 365.25;
+    double erases0 = counters0.erases / years, erases1 = counters1.erases / years;
+    double worst = std::max(erases0, erases1);
+    uint64_t switches = flash.tracer().switches;
+
+    printf("writes,switches,bank0_erases_per_year,bank1_erases_per_year,days_between_switches,years_to_endurance\n");
+    printf("%llu,%llu,%.3f,%.3f,%.3f,%.3f\n",
+           (unsigned long long) options.writes,
+           (unsigned long long) switches,
+           erases0,
+           erases1,
+           switches ? options.writes / options.rate / switches : std::numeric_limits<double>::infinity(),
+           worst > 0 ? options.endurance / worst : std::numeric_limits<double>::infinity());
+
+    return 0;
+}
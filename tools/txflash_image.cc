@@ -0,0 +1,139 @@
+/**
+ * TxFlash bank image builder.
+ *
+ * Builds the bank0 and bank1 images of a flash holding the given payload file as its only record, in TxFlash's record
+ * format for the given bank length, empty value, position size and payload alignment (the Alignment of the TxFlash
+ * instance reading them). The images can be programmed along with the firmware image, so that the first boot finds a
+ * valid configuration without erasing or writing anything.
+ *
+ * Usage: txflash_image --bank-length=N [--empty=0xff] [--position-size=2|4|8] [--alignment=1|2|4|8] PAYLOAD BANK0 BANK1
+ *
+ * @author Andrea Leofreddi
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <vector>
+
+#include <txflash_image.hh>
+
+namespace {
+
+struct Options {
+    uint64_t bank_length = 0;
+    uint8_t empty_value = 0xff;
+    unsigned position_size = 2;
+    unsigned alignment = 1;
+    const char *paths[3] = {nullptr, nullptr, nullptr};
+};
+
+bool parse_options(int argc, char **argv, Options &options) {
+    size_t paths = 0;
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        char *end = nullptr;
+
+        if (!strncmp(arg, "--bank-length=", 14)) {
+            options.bank_length = strtoull(arg + 14, &end, 0);
+        } else if (!strncmp(arg, "--empty=", 8)) {
+            unsigned long value = strtoul(arg + 8, &end, 0);
+            if (value != 0x00 && value != 0xff)
+                return false;
+            options.empty_value = (uint8_t) value;
+        } else if (!strncmp(arg, "--position-size=", 16)) {
+            options.position_size = strtoul(arg + 16, &end, 0);
+            if (options.position_size != 2 && options.position_size != 4 && options.position_size != 8)
+                return false;
+        } else if (!strncmp(arg, "--alignment=", 12)) {
+            options.alignment = strtoul(arg + 12, &end, 0);
+            if (options.alignment != 1 && options.alignment != 2 && options.alignment != 4 && options.alignment != 8)
+                return false;
+        } else if (arg[0] != '-' && paths < 3) {
+            options.paths[paths++] = arg;
+            continue;
+        }
+
+        if (!end || *end)
+            return false;
+    }
+
+    return options.bank_length && paths == 3;
+}
+
+template<uint8_t EmptyValue, typename Position>
+bool build(std::vector<uint8_t> &bank0, std::vector<uint8_t> &bank1, const std::vector<uint8_t> &payload,
+           const Options &options) {
+    if (payload.size() > std::numeric_limits<Position>::max())
+        return false;
+
+    switch (options.alignment) {
+        case 1:
+            return txflash::build_image<EmptyValue, Position, 1>(
+                    bank0.data(), bank1.data(), options.bank_length, payload.data(), payload.size());
+        case 2:
+            return txflash::build_image<EmptyValue, Position, 2>(
+                    bank0.data(), bank1.data(), options.bank_length, payload.data(), payload.size());
+        case 4:
+            return txflash::build_image<EmptyValue, Position, 4>(
+                    bank0.data(), bank1.data(), options.bank_length, payload.data(), payload.size());
+        default:
+            return txflash::build_image<EmptyValue, Position, 8>(
+                    bank0.data(), bank1.data(), options.bank_length, payload.data(), payload.size());
+    }
+}
+
+template<uint8_t EmptyValue>
+bool build(std::vector<uint8_t> &bank0, std::vector<uint8_t> &bank1, const std::vector<uint8_t> &payload,
+           const Options &options) {
+    switch (options.position_size) {
+        case 2:
+            return build<EmptyValue, uint16_t>(bank0, bank1, payload, options);
+        case 4:
+            return build<EmptyValue, uint32_t>(bank0, bank1, payload, options);
+        default:
+            return build<EmptyValue, uint64_t>(bank0, bank1, payload, options);
+    }
+}
+
+bool save(const char *path, const std::vector<uint8_t> &data) {
+    std::ofstream output(path, std::ios::binary);
+    output.write((const char *) data.data(), data.size());
+    return output.good();
+}
+
+}
+
+int main(int argc, char **argv) {
+    Options options;
+    if (!parse_options(argc, argv, options)) {
+        fprintf(stderr, "Usage: %s --bank-length=N [--empty=0xff] [--position-size=2|4|8] [--alignment=1|2|4|8] "
+                        "PAYLOAD BANK0 BANK1\n", argv[0]);
+        return 2;
+    }
+
+    std::ifstream input(options.paths[0], std::ios::binary);
+    std::vector<uint8_t> payload((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+    if (!input.is_open()) {
+        fprintf(stderr, "Cannot read payload %s\n", options.paths[0]);
+        return 1;
+    }
+
+    std::vector<uint8_t> bank0(options.bank_length), bank1(options.bank_length);
+    bool built = options.empty_value ? build<0xff>(bank0, bank1, payload, options)
+                                     : build<0x00>(bank0, bank1, payload, options);
+    if (!built) {
+        fprintf(stderr, "A %zu bytes payload does not fit %llu bytes banks with %u bytes positions and %u bytes alignment\n",
+                payload.size(), (unsigned long long) options.bank_length, options.position_size, options.alignment);
+        return 1;
+    }
+
+    if (!save(options.paths[1], bank0) || !save(options.paths[2], bank1)) {
+        fprintf(stderr, "Cannot write bank images\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,287 @@
+/**
+ * TxFlash bank image inspector.
+ *
+ * Decodes pairs of bank dumps (bank0 and bank1 of a device) using the TxFlash record format, printing as CSV one line
+ * per device with the flash state, the active record, the fill level of the active bank, the estimated writes left
+ * before the next bank switch (at the active bank's average payload length) and whether a torn write has been found.
+ * With --records, every record of both banks is listed instead, along with its validity.
+ *
+ * Dumps are memory mapped, so multi-MiB images only cost the pages actually visited by the record walk. Any number of
+ * devices can be given on the command line, for bulk triage.
+ *
+ * Usage: txflash_inspect [--empty=0xff] [--position-size=2|4|8] [--rate=WRITES_PER_DAY] [--records]
+ *                        BANK0 BANK1 [BANK0 BANK1 ...]
+ *
+ * @author Andrea Leofreddi
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <txflash_format.hh>
+
+namespace {
+
+struct Options {
+    uint8_t empty_value = 0xff;
+    unsigned position_size = 2;
+    double rate = 0;
+    bool records = false;
+    std::vector<const char *> paths;
+};
+
+/**
+ * Read-only memory mapping of a bank dump.
+ */
+class MappedImage {
+public:
+    explicit MappedImage(const char *path) : m_data(nullptr), m_length(0) {
+        int fd = open(path, O_RDONLY);
+        struct stat info;
+
+        if (fd < 0)
+            return;
+        if (!fstat(fd, &info) && info.st_size > 0) {
+            void *data = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data != MAP_FAILED) {
+                m_data = (const uint8_t *) data;
+                m_length = info.st_size;
+            }
+        }
+        close(fd);
+    }
+
+    MappedImage(const MappedImage &) = delete;
+
+    MappedImage &operator=(const MappedImage &) = delete;
+
+    ~MappedImage() {
+        if (m_data)
+            munmap((void *) m_data, m_length);
+    }
+
+    const uint8_t *data() const {
+        return m_data;
+    }
+
+    size_t length() const {
+        return m_length;
+    }
+
+private:
+    const uint8_t *m_data;
+    size_t m_length;
+};
+
+/**
+ * Read-only bank over a mapped image.
+ */
+template<uint8_t EmptyValue>
+class ImageBank {
+public:
+    static const uint8_t empty_value = EmptyValue;
+    using position_t = uint64_t;
+
+    explicit ImageBank(const MappedImage &image) : m_image(image) {
+    }
+
+    position_t length() const {
+        return m_image.length();
+    }
+
+    void read_chunk(position_t position, void *destination, position_t length) const {
+        memcpy(destination, m_image.data() + position, length);
+    }
+
+private:
+    const MappedImage &m_image;
+};
+
+/**
+ * Tracer keeping track of torn records met while locating the active one.
+ */
+struct TornTracer : txflash::NullTracer {
+    bool torn = false;
+
+    void recovery(txflash::Recovery reason, uint8_t /* bank */, uint32_t /* position */) {
+        torn |= reason == txflash::Recovery::TORN_RECORD;
+    }
+};
+
+const char *status_name(uint8_t status) {
+    static const char *names[] = {"valid", "end", "torn", "open", "bad_length", "bad_header"};
+    return status < sizeof(names) / sizeof(names[0]) ? names[status] : "unknown";
+}
+
+const char *state_name(uint8_t state) {
+    static const char *names[] = {"empty", "valid", "invalid"};
+    return state < sizeof(names) / sizeof(names[0]) ? names[state] : "unknown";
+}
+
+template<uint8_t EmptyValue, typename Position>
+bool inspect(const char *path0, const char *path1, const Options &options) {
+    using Format = txflash::RecordFormat<EmptyValue, Position>;
+    using Record = typename Format::Record;
+    using Status = typename Format::Status;
+
+    MappedImage image0(path0), image1(path1);
+    const MappedImage *images[] = {&image0, &image1};
+
+    for (const MappedImage *image : images) {
+        if (!image->data() || image->length() < 2 || image->length() - 1 > (Position) -1) {
+            fprintf(stderr, "Cannot inspect %s: unreadable, too short or too long for the position size\n",
+                    image == &image0 ? path0 : path1);
+            return false;
+        }
+    }
+
+    ImageBank<EmptyValue> bank0(image0), bank1(image1);
+    typename Format::Cursor cursor;
+    TornTracer tracer;
+    typename Format::State state = Format::locate(bank0, bank1, cursor, tracer);
+    const ImageBank<EmptyValue> &active = cursor.bank ? bank1 : bank0;
+
+    if (options.records) {
+        for (uint8_t id = 0; id < 2; id++) {
+            const ImageBank<EmptyValue> &bank = id ? bank1 : bank0;
+
+            uint8_t version = Format::bank_version(bank);
+            Position alignment = Format::bank_alignment(bank), first = Format::first(version, alignment);
+
+            // Corrupted bank headers can claim a newer version, or place the first record past the end of the bank
+            if (version > Format::version || first >= bank.length()) {
+                printf("%s,%u,0,0,%s,0\n", path0, id, status_name((uint8_t) Status::BAD_HEADER));
+                continue;
+            }
+
+            for (Position position = first;;) {
+                Record record = Format::probe(bank, position, alignment);
+                if (record.status == Status::END)
+                    break;
+
+                bool is_active = state == Format::State::VALID && id == cursor.bank && position == cursor.read_position;
+                printf("%s,%u,%llu,%llu,%s,%d\n", path0, id, (unsigned long long) position,
+                       (unsigned long long) record.length, status_name((uint8_t) record.status), is_active);
+
+                if (record.status != Status::VALID)
+                    break;
+                position += Format::size(record.length, alignment);
+            }
+        }
+        return true;
+    }
+
+    // Walk the active bank again for the average payload length
+    uint64_t records = 0, payload = 0;
+    Position length = 0;
+    bool torn = tracer.torn;
+
+    if (state == Format::State::VALID) {
+        for (Position position = Format::first(cursor.version, cursor.alignment);;) {
+            Record record = Format::probe(active, position, cursor.alignment);
+            if (record.status != Status::VALID)
+                break;
+            records++;
+            payload += record.length;
+            position += Format::size(record.length, cursor.alignment);
+        }
+        length = Format::length(active, cursor.read_position);
+    }
+
+    // Count the average sized records still fitting the active bank
+    uint64_t writes = 0;
+    if (records) {
+        Position remaining = active.length() - cursor.write_position, average = payload / records;
+        if (Format::fits(remaining, average, cursor.alignment))
+            writes = (remaining - 1 /* next header */) / Format::size(average, cursor.alignment);
+    }
+
+    printf("%s,%s,", path0, state_name((uint8_t) state));
+    if (state == Format::State::VALID) {
+        printf("%u,%llu,%llu,%llu,%.1f,%llu,", cursor.bank, (unsigned long long) cursor.read_position,
+               (unsigned long long) length, (unsigned long long) records,
+               100.0 * cursor.write_position / active.length(), (unsigned long long) writes);
+        if (options.rate > 0)
+            printf("%.1f", writes / options.rate);
+    } else {
+        printf(",,,,,,");
+    }
+    printf(",%d\n", torn);
+
+    return true;
+}
+
+template<uint8_t EmptyValue>
+bool inspect(const char *path0, const char *path1, const Options &options) {
+    switch (options.position_size) {
+        case 2:
+            return inspect<EmptyValue, uint16_t>(path0, path1, options);
+        case 4:
+            return inspect<EmptyValue, uint32_t>(path0, path1, options);
+        default:
+            return inspect<EmptyValue, uint64_t>(path0, path1, options);
+    }
+}
+
+bool parse_options(int argc, char **argv, Options &options) {
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        char *end = nullptr;
+
+        if (!strncmp(arg, "--empty=", 8)) {
+            unsigned long value = strtoul(arg + 8, &end, 0);
+            if (value != 0x00 && value != 0xff)
+                return false;
+            options.empty_value = (uint8_t) value;
+        } else if (!strncmp(arg, "--position-size=", 16)) {
+            options.position_size = strtoul(arg + 16, &end, 0);
+            if (options.position_size != 2 && options.position_size != 4 && options.position_size != 8)
+                return false;
+        } else if (!strncmp(arg, "--rate=", 7)) {
+            options.rate = strtod(arg + 7, &end);
+        } else if (!strcmp(arg, "--records")) {
+            options.records = true;
+            continue;
+        } else if (arg[0] != '-') {
+            options.paths.push_back(arg);
+            continue;
+        }
+
+        if (!end || *end)
+            return false;
+    }
+
+    return !options.paths.empty() && options.paths.size() % 2 == 0;
+}
+
+}
+
+int main(int argc, char **argv) {
+    Options options;
+    if (!parse_options(argc, argv, options)) {
+        fprintf(stderr, "Usage: %s [--empty=0xff] [--position-size=2|4|8] [--rate=WRITES_PER_DAY] [--records] "
+                        "BANK0 BANK1 [BANK0 BANK1 ...]\n", argv[0]);
+        return 2;
+    }
+
+    if (options.records)
+        printf("device,bank,offset,length,status,active\n");
+    else
+        printf("device,state,active_bank,active_offset,active_length,records,fill_percent,writes_to_switch,"
+               "days_to_switch,torn\n");
+
+    int result = 0;
+    for (size_t i = 0; i < options.paths.size(); i += 2) {
+        bool inspected = options.empty_value ? inspect<0xff>(options.paths[i], options.paths[i + 1], options)
+                                             : inspect<0x00>(options.paths[i], options.paths[i + 1], options);
+        if (!inspected)
+            result = 1;
+    }
+    return result;
+}
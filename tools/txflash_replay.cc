@@ -0,0 +1,207 @@
+/**
+ * TxFlash trace replay tool.
+ *
+ * Replays a flash trace captured by RecordingFlashBank, printing the resulting operation counts and elapsed time as CSV.
+ *
+ * In raw mode (default) the traced bank operations are replayed as they are against simulated NOR banks. In logical
+ * mode the payloads committed in the trace are extracted and written again through a TxFlash instance, optionally
+ * using a different bank length, so that alternative configurations can be compared on real write patterns.
+ *
+ * Usage: txflash_replay [--logical] [--bank-length=N] trace.bin
+ *
+ * @author Andrea Leofreddi
+ */
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include <txflash.hh>
+#include <txflash_nor.hh>
+#include <txflash_recorder.hh>
+
+namespace {
+
+using txflash::NorFlashBank;
+using txflash::NorFlashCounters;
+using txflash::TraceEvent;
+using txflash::TraceOp;
+using txflash::TraceReader;
+
+struct Options {
+    bool logical = false;
+    uint64_t bank_length = 0;
+    const char *path = nullptr;
+};
+
+/**
+ * Traced banks geometry, as declared by OPEN events.
+ */
+struct Geometry {
+    uint64_t length[2] = {0, 0};
+    uint8_t empty_value = 0xff;
+    uint8_t position_size = 0;
+};
+
+bool read_geometry(const std::vector<uint8_t> &trace, Geometry &geometry) {
+    TraceReader reader(trace.data(), trace.size());
+
+    for (TraceEvent event; reader.next(event);) {
+        if (event.op == TraceOp::OPEN && event.bank < 2) {
+            geometry.length[event.bank] = event.length;
+            geometry.empty_value = event.empty_value;
+            geometry.position_size = event.position_size;
+        }
+    }
+    return reader.valid() && geometry.length[0] && geometry.length[1];
+}
+
+void report(const char *mode, const NorFlashCounters &counters, std::chrono::steady_clock::duration elapsed) {
+    printf("mode,erases,programs,programmed_bytes,reads,read_bytes,elapsed_ns\n");
+    printf("%s,%u,%u,%u,%u,%u,%lld\n", mode, counters.erases, counters.programs, counters.programmed_bytes,
+           counters.reads, counters.read_bytes,
+           (long long) std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+}
+
+NorFlashCounters sum(const NorFlashCounters &a, const NorFlashCounters &b) {
+    return NorFlashCounters{
+            a.erases + b.erases,
+            a.programs + b.programs,
+            a.programmed_bytes + b.programmed_bytes,
+            a.reads + b.reads,
+            a.read_bytes + b.read_bytes
+    };
+}
+
+template<uint8_t EmptyValue>
+int replay_raw(const std::vector<uint8_t> &trace, const Geometry &geometry, const Options &options) {
+    std::vector<uint8_t> data0(std::max(options.bank_length, geometry.length[0]), EmptyValue);
+    std::vector<uint8_t> data1(std::max(options.bank_length, geometry.length[1]), EmptyValue);
+    NorFlashCounters counters0 = {}, counters1 = {};
+    NorFlashBank<EmptyValue, uint64_t> bank0(data0.data(), data0.size(), &counters0), bank1(data1.data(), data1.size(), &counters1);
+
+    TraceReader reader(trace.data(), trace.size());
+    auto begin = std::chrono::steady_clock::now();
+    bool valid = txflash::replay_trace(reader, bank0, bank1);
+    auto elapsed = std::chrono::steady_clock::now() - begin;
+
+    if (!valid) {
+        fprintf(stderr, "Malformed trace\n");
+        return 1;
+    }
+    report("raw", sum(counters0, counters1), elapsed);
+    return 0;
+}
+
+/**
+ * Extracts the payloads committed in the trace, in commit order. A record is committed by programming its header alone,
+ * after its length and payload, so the trace is applied to shadow banks and the record is read back from them.
+ */
+std::vector<std::string> committed_payloads(const std::vector<uint8_t> &trace, const Geometry &geometry) {
+    std::vector<std::string> payloads;
+    std::vector<uint8_t> shadow[2] = {
+            std::vector<uint8_t>(geometry.length[0], geometry.empty_value),
+            std::vector<uint8_t>(geometry.length[1], geometry.empty_value)
+    };
+    const uint8_t record = (uint8_t) (geometry.empty_value + 1);
+
+    TraceReader reader(trace.data(), trace.size());
+    for (TraceEvent event; reader.next(event);) {
+        if (event.bank > 1)
+            continue;
+
+        std::vector<uint8_t> &bank = shadow[event.bank];
+        if (event.op == TraceOp::ERASE) {
+            std::fill(bank.begin(), bank.end(), geometry.empty_value);
+        } else if (event.op == TraceOp::WRITE && event.position <= bank.size() && event.length <= bank.size() - event.position) {
+            std::copy(event.data, event.data + event.length, bank.begin() + event.position);
+
+            uint64_t offset = event.position + 1 /* header */ + geometry.position_size /* length */, length = 0;
+            if (event.length != 1 || event.data[0] != record || offset > bank.size())
+                continue;
+
+            for (uint8_t i = 0; i < geometry.position_size; i++)
+                length |= (uint64_t) bank[event.position + 1 + i] << (8 * i);
+            if (offset + length <= bank.size())
+                payloads.emplace_back((const char *) bank.data() + offset, length);
+        }
+    }
+    return payloads;
+}
+
+template<uint8_t EmptyValue>
+int replay_logical(const std::vector<uint8_t> &trace, const Geometry &geometry, const Options &options) {
+    using Bank = NorFlashBank<EmptyValue, uint32_t>;
+
+    std::vector<std::string> payloads = committed_payloads(trace, geometry);
+    if (payloads.empty()) {
+        fprintf(stderr, "No committed payload found in trace\n");
+        return 1;
+    }
+
+    std::vector<uint8_t> data0(options.bank_length ? options.bank_length : geometry.length[0], EmptyValue);
+    std::vector<uint8_t> data1(options.bank_length ? options.bank_length : geometry.length[1], EmptyValue);
+    NorFlashCounters counters0 = {}, counters1 = {};
+
+    auto begin = std::chrono::steady_clock::now();
+    auto flash = txflash::make_txflash(
+            Bank(data0.data(), data0.size(), &counters0),
+            Bank(data1.data(), data1.size(), &counters1),
+            payloads[0].data(), payloads[0].size()
+    );
+    for (size_t i = 1; i < payloads.size(); i++) {
+        if (!flash.write(payloads[i].data(), payloads[i].size())) {
+            fprintf(stderr, "Payload #%zu (%zu bytes) does not fit the banks\n", i, payloads[i].size());
+            return 1;
+        }
+    }
+    auto elapsed = std::chrono::steady_clock::now() - begin;
+
+    report("logical", sum(counters0, counters1), elapsed);
+    return 0;
+}
+
+}
+
+int main(int argc, char **argv) {
+    Options options;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--logical"))
+            options.logical = true;
+        else if (!strncmp(argv[i], "--bank-length=", 14))
+            options.bank_length = strtoull(argv[i] + 14, nullptr, 0);
+        else if (argv[i][0] != '-' && !options.path)
+            options.path = argv[i];
+        else
+            options.path = nullptr, i = argc;
+    }
+
+    if (!options.path) {
+        fprintf(stderr, "Usage: %s [--logical] [--bank-length=N] trace.bin\n", argv[0]);
+        return 2;
+    }
+
+    std::ifstream input(options.path, std::ios::binary);
+    std::vector<uint8_t> trace((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+    Geometry geometry;
+
+    if (!input.is_open() || !read_geometry(trace, geometry)) {
+        fprintf(stderr, "Cannot read trace %s\n", options.path);
+        return 1;
+    }
+
+    switch (geometry.empty_value) {
+        case 0x00:
+            return options.logical ? replay_logical<0x00>(trace, geometry, options) : replay_raw<0x00>(trace, geometry, options);
+        case 0xff:
+            return options.logical ? replay_logical<0xff>(trace, geometry, options) : replay_raw<0xff>(trace, geometry, options);
+        default:
+            fprintf(stderr, "Unsupported empty value 0x%02x\n", geometry.empty_value);
+            return 1;
+    }
+}